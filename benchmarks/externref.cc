@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+#include <wasmtime.hh>
+
+#include "fixture.hh"
+
+using namespace wasmtime;
+
+namespace {
+
+void ExternRefCreate(benchmark::State &state) {
+  Fixture fx;
+  for (auto _ : state) {
+    ExternRef ref(fx.store, 42);
+    benchmark::DoNotOptimize(&ref);
+    ref.unroot(fx.store);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(ExternRefCreate);
+
+void ExternRefClone(benchmark::State &state) {
+  Fixture fx;
+  ExternRef ref(fx.store, 42);
+  for (auto _ : state) {
+    ExternRef other = ref.clone(fx.store);
+    benchmark::DoNotOptimize(&other);
+    other.unroot(fx.store);
+  }
+  state.SetItemsProcessed(state.iterations());
+  ref.unroot(fx.store);
+}
+BENCHMARK(ExternRefClone);
+
+void ExternRefData(benchmark::State &state) {
+  Fixture fx;
+  ExternRef ref(fx.store, 42);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(std::any_cast<int>(*ref.data(fx.store)));
+  }
+  state.SetItemsProcessed(state.iterations());
+  ref.unroot(fx.store);
+}
+BENCHMARK(ExternRefData);
+
+void TypedExternRefCreate(benchmark::State &state) {
+  Fixture fx;
+  for (auto _ : state) {
+    auto ref = TypedExternRef<int>::make(fx.store, 42);
+    benchmark::DoNotOptimize(&ref);
+    ref.unroot(fx.store);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(TypedExternRefCreate);
+
+void TypedExternRefData(benchmark::State &state) {
+  Fixture fx;
+  auto ref = TypedExternRef<int>::make(fx.store, 42);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(*ref.get(fx.store));
+  }
+  state.SetItemsProcessed(state.iterations());
+  ref.unroot(fx.store);
+}
+BENCHMARK(TypedExternRefData);
+
+void RootScopeBatch(benchmark::State &state) {
+  Fixture fx;
+  const auto n = static_cast<size_t>(state.range(0));
+  for (auto _ : state) {
+    RootScope scope(fx.store);
+    scope.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      benchmark::DoNotOptimize(scope.make<int>(static_cast<int>(i)));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(RootScopeBatch)->Arg(1000);
+
+} // namespace
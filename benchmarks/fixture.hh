@@ -0,0 +1,29 @@
+#ifndef WASMTIME_BENCHMARKS_FIXTURE_HH
+#define WASMTIME_BENCHMARKS_FIXTURE_HH
+
+#include <string_view>
+#include <vector>
+#include <wasmtime.hh>
+
+// An engine and a store to run a benchmark in, shared by the benchmarks which
+// don't need any particular configuration.
+struct Fixture {
+  wasmtime::Engine engine;
+  wasmtime::Store store{engine};
+
+  // Compiles `wat` and instantiates it in `store` with `imports`.
+  wasmtime::Instance
+  instantiate(std::string_view wat,
+              const std::vector<wasmtime::Extern> &imports = {}) {
+    wasmtime::Module m = wasmtime::Module::compile(engine, wat).unwrap();
+    return wasmtime::Instance::create(store, m, imports).unwrap();
+  }
+
+  // Instantiates `wat` and returns its export `name`, which must be a `T`.
+  template <typename T> T load(std::string_view wat, std::string_view name) {
+    wasmtime::Instance i = instantiate(wat);
+    return std::get<T>(*i.get(store, name));
+  }
+};
+
+#endif // WASMTIME_BENCHMARKS_FIXTURE_HH
@@ -0,0 +1,129 @@
+#include <benchmark/benchmark.h>
+#include <wasmtime.hh>
+
+#include "fixture.hh"
+
+using namespace wasmtime;
+
+namespace {
+
+const char *kAddWat = R"(
+  (module
+    (func (export "add") (param i32 i32) (result i32)
+      local.get 0
+      local.get 1
+      i32.add))
+)";
+
+using AddParams = std::tuple<int32_t, int32_t>;
+
+struct AddFixture : Fixture {
+  TypedFunc<AddParams, int32_t> add =
+      load<Func>(kAddWat, "add").typed<AddParams, int32_t>(store).unwrap();
+
+  std::vector<AddParams> batch(size_t n) {
+    std::vector<AddParams> params;
+    params.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      params.emplace_back(int32_t(i), 1);
+    }
+    return params;
+  }
+};
+
+void TypedFuncCallLoop(benchmark::State &state) {
+  AddFixture fx;
+  auto params = fx.batch(state.range(0));
+  std::vector<int32_t> results(params.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < params.size(); i++) {
+      results[i] = fx.add.call(fx.store, params[i]).unwrap();
+    }
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.SetItemsProcessed(state.iterations() * params.size());
+}
+BENCHMARK(TypedFuncCallLoop)->Arg(10000)->Arg(100000);
+
+void TypedFuncCallMany(benchmark::State &state) {
+  AddFixture fx;
+  auto params = fx.batch(state.range(0));
+  std::vector<int32_t> results(params.size());
+  for (auto _ : state) {
+    fx.add.call_many(fx.store, params, results).unwrap();
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.SetItemsProcessed(state.iterations() * params.size());
+}
+BENCHMARK(TypedFuncCallMany)->Arg(10000)->Arg(100000);
+
+// A single call through the dynamically typed `Func::call`, which allocates
+// its result vector every time.
+void FuncCall(benchmark::State &state) {
+  AddFixture fx;
+  Func f = fx.add.func();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f.call(fx.store, {1, 2}).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(FuncCall);
+
+// The same call through `TypedFunc::call`.
+void TypedFuncCall(benchmark::State &state) {
+  AddFixture fx;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fx.add.call(fx.store, {1, 2}).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(TypedFuncCall);
+
+const char *kHostWat = R"(
+  (module
+    (import "host" "f" (func $f (param i32) (result i32)))
+    (func (export "run") (param i32) (result i32)
+      local.get 0
+      call $f))
+)";
+
+// Calls a wasm function which immediately calls back into `host`.
+void host_round_trip(benchmark::State &state, Fixture &fx, Func host) {
+  Instance i = fx.instantiate(kHostWat, {host});
+  auto run = std::get<Func>(*i.get(fx.store, "run"))
+                 .typed<int32_t, int32_t>(fx.store)
+                 .unwrap();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(run.call(fx.store, 7).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void HostCallWrap(benchmark::State &state) {
+  Fixture fx;
+  Func host = Func::wrap(fx.store, [](int32_t x) { return x + 1; });
+  host_round_trip(state, fx, host);
+}
+BENCHMARK(HostCallWrap);
+
+void HostCallWrapNoexcept(benchmark::State &state) {
+  Fixture fx;
+  Func host = Func::wrap_noexcept(fx.store, [](int32_t x) { return x + 1; });
+  host_round_trip(state, fx, host);
+}
+BENCHMARK(HostCallWrapNoexcept);
+
+void HostCallNew(benchmark::State &state) {
+  Fixture fx;
+  FuncType ty({ValKind::I32}, {ValKind::I32});
+  Func host(fx.store, ty,
+            [](Caller, Span<const Val> params,
+               Span<Val> results) -> Result<std::monostate, Trap> {
+              results[0] = params[0].i32() + 1;
+              return std::monostate();
+            });
+  host_round_trip(state, fx, host);
+}
+BENCHMARK(HostCallNew);
+
+} // namespace
@@ -0,0 +1,223 @@
+#include <benchmark/benchmark.h>
+#include <wasmtime.hh>
+
+#include "fixture.hh"
+
+using namespace wasmtime;
+
+namespace {
+
+// A small module resembling a typical per-request handler: one page of
+// memory, a table, and a function touching both.
+const char *kHandlerWat = R"(
+  (module
+    (memory (export "memory") 1)
+    (table 10 funcref)
+    (func (export "handle") (param i32) (result i32)
+      local.get 0
+      local.get 0
+      i32.store
+      local.get 0
+      i32.load))
+)";
+
+void instantiate_per_request(benchmark::State &state, Engine engine) {
+  Module m = Module::compile(engine, kHandlerWat).unwrap();
+  for (auto _ : state) {
+    Store store(engine);
+    Instance i = Instance::create(store, m, {}).unwrap();
+    Func f = std::get<Func>(*i.get(store, "handle"));
+    auto handle = f.typed<int32_t, int32_t>(store).unwrap();
+    benchmark::DoNotOptimize(handle.call(store, 16).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void InstantiateOnDemand(benchmark::State &state) {
+  instantiate_per_request(state, Engine());
+}
+BENCHMARK(InstantiateOnDemand);
+
+#ifdef WASMTIME_FEATURE_POOLING_ALLOCATOR
+void InstantiatePooling(benchmark::State &state) {
+  PoolingAllocationConfig pooling;
+  pooling.total_core_instances(100);
+  pooling.total_memories(100);
+  pooling.total_tables(100);
+  pooling.max_memory_size(1 << 20);
+  Config config;
+  config.pooling_allocation_strategy(pooling);
+  instantiate_per_request(state, Engine(std::move(config)));
+}
+BENCHMARK(InstantiatePooling);
+#endif
+
+const char *kImportsWat = R"(
+  (module
+    (import "host" "a" (func (param i32) (result i32)))
+    (import "host" "b" (func (param i32) (result i32)))
+    (import "host" "c" (func (param i32) (result i32)))
+    (import "host" "d" (func (param i32) (result i32)))
+    (memory 1))
+)";
+
+Linker host_linker(Engine &engine) {
+  Linker linker(engine);
+  for (const char *name : {"a", "b", "c", "d"}) {
+    linker.func_wrap("host", name, [](int32_t x) { return x; }).unwrap();
+  }
+  return linker;
+}
+
+void LinkerInstantiate(benchmark::State &state) {
+  Engine engine;
+  Linker linker = host_linker(engine);
+  Module m = Module::compile(engine, kImportsWat).unwrap();
+  for (auto _ : state) {
+    Store store(engine);
+    benchmark::DoNotOptimize(linker.instantiate(store, m).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(LinkerInstantiate);
+
+void InstanceCreate(benchmark::State &state) {
+  Engine engine;
+  Module m = Module::compile(engine, kImportsWat).unwrap();
+  for (auto _ : state) {
+    Store store(engine);
+    std::vector<Extern> imports;
+    for (int n = 0; n < 4; n++) {
+      imports.push_back(Func::wrap(store, [](int32_t x) { return x; }));
+    }
+    benchmark::DoNotOptimize(Instance::create(store, m, imports).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(InstanceCreate);
+
+// Like `InstanceCreate`, but reusing one `ImportList` across stores.
+void InstanceCreateImportList(benchmark::State &state) {
+  Engine engine;
+  Module m = Module::compile(engine, kImportsWat).unwrap();
+  ImportList imports;
+  imports.reserve(4);
+  for (auto _ : state) {
+    Store store(engine);
+    for (size_t n = 0; n < 4; n++) {
+      Func f = Func::wrap(store, [](int32_t x) { return x; });
+      if (n < imports.size()) {
+        imports.set(n, f);
+      } else {
+        imports.push_back(f);
+      }
+    }
+    benchmark::DoNotOptimize(Instance::create(store, m, imports).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(InstanceCreateImportList);
+
+const char *kExportsWat = R"(
+  (module
+    (memory (export "memory") 1)
+    (global (export "counter") (mut i32) (i32.const 0))
+    (func (export "init"))
+    (func (export "handle") (param i32) (result i32) local.get 0)
+    (func (export "finish")))
+)";
+
+// Looks up every handler export of a fresh instance by name.
+void ExportsByName(benchmark::State &state) {
+  Fixture fx;
+  Instance i = fx.instantiate(kExportsWat);
+  for (auto _ : state) {
+    for (const char *name :
+         {"memory", "counter", "init", "handle", "finish"}) {
+      benchmark::DoNotOptimize(i.get(fx.store, name));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 5);
+}
+BENCHMARK(ExportsByName);
+
+// Loads the same exports in one pass through an `ExportIndex`.
+void ExportsByIndex(benchmark::State &state) {
+  Fixture fx;
+  Module m = Module::compile(fx.engine, kExportsWat).unwrap();
+  ExportIndex index(m);
+  Instance i = Instance::create(fx.store, m, {}).unwrap();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(i.exports(fx.store, index).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations() * 5);
+}
+BENCHMARK(ExportsByIndex);
+
+void InstancePreInstantiate(benchmark::State &state) {
+  Engine engine;
+  Linker linker = host_linker(engine);
+  Module m = Module::compile(engine, kImportsWat).unwrap();
+  InstancePre pre = linker.instantiate_pre(m).unwrap();
+  for (auto _ : state) {
+    Store store(engine);
+    benchmark::DoNotOptimize(pre.instantiate(store).unwrap());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(InstancePreInstantiate);
+
+void StorePoolCheckout(benchmark::State &state) {
+  Engine engine;
+  Linker linker = host_linker(engine);
+  Module m = Module::compile(engine, kImportsWat).unwrap();
+  StorePool pool(engine, 64);
+  pool.instantiate(linker.instantiate_pre(m).unwrap());
+  for (auto _ : state) {
+    auto lease = pool.checkout().unwrap();
+    benchmark::DoNotOptimize(lease.instance());
+  }
+  auto stats = pool.stats();
+  state.counters["hit_rate"] = stats.hit_rate();
+  state.counters["checkout_ns"] =
+      static_cast<double>(stats.mean_checkout_time().count());
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(StorePoolCheckout);
+
+// Compares a fresh instance per checkout with and without copy-on-write memory
+// images, for a module with data segments at both ends of its page.
+void StorePoolReuse(benchmark::State &state) {
+  Config config;
+  config.memory_init_cow(state.range(0) != 0);
+  Engine engine(std::move(config));
+  Linker linker(engine);
+  auto wasm = wat2wasm(R"(
+    (module
+      (memory (export "memory") 1)
+      (data (i32.const 0) "\01")
+      (data (i32.const 65535) "\01")
+      (func (export "handle") (param i32) (result i32)
+        local.get 0
+        local.get 0
+        i32.store
+        local.get 0
+        i32.load))
+  )").unwrap();
+  Module m = Module::compile(engine, wasm).unwrap();
+  StorePool pool(engine, 64);
+  pool.instantiate(linker.instantiate_pre(m).unwrap());
+  for (auto _ : state) {
+    auto lease = pool.checkout().unwrap();
+    Instance instance = *lease.instance();
+    Func f = std::get<Func>(*instance.get(lease.store(), "handle"));
+    auto handle = f.typed<int32_t, int32_t>(lease.store()).unwrap();
+    benchmark::DoNotOptimize(handle.call(lease.store(), 16).unwrap());
+  }
+  state.counters["checkout_ns"] =
+      static_cast<double>(pool.stats().mean_checkout_time().count());
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(StorePoolReuse)->Arg(0)->Arg(1);
+
+} // namespace
@@ -0,0 +1,62 @@
+#include <benchmark/benchmark.h>
+#include <wasmtime.hh>
+
+#include "fixture.hh"
+
+using namespace wasmtime;
+
+namespace {
+
+struct MemoryFixture : Fixture {
+  Memory memory = load<Memory>("(module (memory (export \"m\") 16))", "m");
+};
+
+// Fetches `Memory::data` for every access, as a host function must whenever
+// guest code may have grown the memory since the last access.
+void MemoryDataPerAccess(benchmark::State &state) {
+  MemoryFixture fx;
+  size_t n = state.range(0);
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+      sum += fx.memory.data(fx.store)[i * 8];
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(MemoryDataPerAccess)->Arg(4096);
+
+// Fetches `Memory::data` once and then accesses the span directly.
+void MemoryDataHoisted(benchmark::State &state) {
+  MemoryFixture fx;
+  size_t n = state.range(0);
+  for (auto _ : state) {
+    auto data = fx.memory.data(fx.store);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+      sum += data[i * 8];
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(MemoryDataHoisted)->Arg(4096);
+
+// Bounds-checked typed reads through a `MemoryView`.
+void MemoryViewRead(benchmark::State &state) {
+  MemoryFixture fx;
+  size_t n = state.range(0);
+  for (auto _ : state) {
+    auto view = fx.memory.view(fx.store);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+      sum += view.read<uint64_t>(i * 8).value_or(0);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(MemoryViewRead)->Arg(4096);
+
+} // namespace
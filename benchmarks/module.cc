@@ -0,0 +1,161 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <wasmtime.hh>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace wasmtime;
+
+namespace {
+
+// Builds a module with enough functions to make its artifact non-trivial.
+std::string large_wat(size_t funcs) {
+  std::stringstream wat;
+  wat << "(module\n";
+  for (size_t i = 0; i < funcs; i++) {
+    wat << "(func (export \"f" << i << "\") (param i32) (result i32)"
+        << " local.get 0 i32.const " << i << " i32.add"
+        << " i32.const 3 i32.mul)\n";
+  }
+  wat << ")";
+  return wat.str();
+}
+
+struct Artifact {
+  Engine engine;
+  std::vector<uint8_t> bytes;
+  std::string path = "bench-module.cwasm";
+
+  Artifact() {
+    Module m = Module::compile(engine, large_wat(2000)).unwrap();
+    bytes = m.serialize().unwrap();
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  }
+  ~Artifact() { std::remove(path.c_str()); }
+};
+
+void report_rss(benchmark::State &state) {
+#ifndef _WIN32
+  struct rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
+  state.counters["max_rss_kb"] = static_cast<double>(usage.ru_maxrss);
+#endif
+}
+
+std::vector<std::vector<uint8_t>> many_binaries(size_t n) {
+  std::vector<std::vector<uint8_t>> ret;
+  for (size_t i = 0; i < n; i++) {
+    ret.push_back(wat2wasm(large_wat(200 + i)).unwrap());
+  }
+  return ret;
+}
+
+// Compiles a batch of modules one after another.
+void CompileSerial(benchmark::State &state) {
+  Engine engine;
+  auto binaries = many_binaries(32);
+  for (auto _ : state) {
+    for (auto &wasm : binaries) {
+      benchmark::DoNotOptimize(Module::compile(engine, wasm).unwrap());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * binaries.size());
+}
+BENCHMARK(CompileSerial)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Compiles the same batch with `Module::compile_many`.
+void CompileMany(benchmark::State &state) {
+  Engine engine;
+  auto binaries = many_binaries(32);
+  std::vector<Span<uint8_t>> wasms(binaries.begin(), binaries.end());
+  Module::CompileManyOptions options;
+  options.threads = state.range(0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Module::compile_many(engine, wasms, options));
+  }
+  state.SetItemsProcessed(state.iterations() * binaries.size());
+}
+BENCHMARK(CompileMany)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+void Serialize(benchmark::State &state) {
+  Engine engine;
+  Module m = Module::compile(engine, large_wat(2000)).unwrap();
+  size_t bytes = 0;
+  for (auto _ : state) {
+    auto serialized = m.serialize().unwrap();
+    bytes = serialized.size();
+    benchmark::DoNotOptimize(serialized.data());
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(Serialize);
+
+// Reads the whole artifact into a heap buffer and deserializes from it.
+void DeserializeCopy(benchmark::State &state) {
+  Artifact artifact;
+  for (auto _ : state) {
+    std::ifstream in(artifact.path, std::ios::binary);
+    std::vector<uint8_t> buf((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+    benchmark::DoNotOptimize(
+        Module::deserialize(artifact.engine, buf).unwrap());
+  }
+  state.SetBytesProcessed(state.iterations() * artifact.bytes.size());
+  report_rss(state);
+}
+BENCHMARK(DeserializeCopy);
+
+void DeserializeFile(benchmark::State &state) {
+  Artifact artifact;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        Module::deserialize_file(artifact.engine, artifact.path).unwrap());
+  }
+  state.SetBytesProcessed(state.iterations() * artifact.bytes.size());
+  report_rss(state);
+}
+BENCHMARK(DeserializeFile);
+
+#ifndef _WIN32
+// Maps the artifact and deserializes straight out of the mapping.
+void DeserializeMapped(benchmark::State &state) {
+  Artifact artifact;
+  for (auto _ : state) {
+    int fd = open(artifact.path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      state.SkipWithError("cannot open artifact");
+      return;
+    }
+    size_t len = artifact.bytes.size();
+    void *base = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+      state.SkipWithError("cannot map artifact");
+      return;
+    }
+    Span<uint8_t> mapped(static_cast<uint8_t *>(base), len);
+    benchmark::DoNotOptimize(
+        Module::deserialize(artifact.engine, mapped).unwrap());
+    munmap(base, len);
+  }
+  state.SetBytesProcessed(state.iterations() * artifact.bytes.size());
+  report_rss(state);
+}
+BENCHMARK(DeserializeMapped);
+#endif
+
+} // namespace
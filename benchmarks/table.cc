@@ -0,0 +1,64 @@
+#include <benchmark/benchmark.h>
+#include <wasmtime.hh>
+
+#include "fixture.hh"
+
+using namespace wasmtime;
+
+namespace {
+
+struct DispatchTable : Fixture {
+  Table table;
+  std::vector<Val> funcs;
+
+  explicit DispatchTable(size_t n)
+      : table(Table::create(store, TableType(ValKind::FuncRef, n),
+                            std::optional<Func>())
+                  .unwrap()) {
+    Func f = Func::wrap(store, [](int32_t a) { return a; });
+    funcs.assign(n, f);
+  }
+};
+
+void TableSetLoop(benchmark::State &state) {
+  DispatchTable t(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    for (size_t i = 0; i < t.funcs.size(); i++) {
+      t.table.set(t.store, i, t.funcs[i]).unwrap();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(TableSetLoop)->Arg(4096);
+
+void TableSetRange(benchmark::State &state) {
+  DispatchTable t(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    t.table.set_range(t.store, 0, t.funcs).unwrap();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(TableSetRange)->Arg(4096);
+
+void TableFill(benchmark::State &state) {
+  DispatchTable t(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    t.table.fill(t.store, 0, t.funcs[0], t.funcs.size()).unwrap();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(TableFill)->Arg(4096);
+
+void TableGetRange(benchmark::State &state) {
+  DispatchTable t(static_cast<size_t>(state.range(0)));
+  t.table.set_range(t.store, 0, t.funcs).unwrap();
+  std::vector<Val> out(t.funcs.size());
+  for (auto _ : state) {
+    t.table.get_range(t.store, 0, out).unwrap();
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(TableGetRange)->Arg(4096);
+
+} // namespace
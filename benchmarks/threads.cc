@@ -0,0 +1,106 @@
+#include <benchmark/benchmark.h>
+#include <thread>
+#include <vector>
+#include <wasmtime.hh>
+
+using namespace wasmtime;
+
+namespace {
+
+// Sums the u32 values in [start, end) and atomically adds the result to the
+// accumulator at address 0.
+const char *kSumWat = R"(
+  (module
+    (import "env" "memory" (memory 1 1024 shared))
+    (func (export "sum") (param $start i32) (param $end i32)
+      (local $acc i64)
+      block $done
+        loop $loop
+          local.get $start
+          local.get $end
+          i32.ge_u
+          br_if $done
+          local.get $acc
+          local.get $start
+          i64.load32_u
+          i64.add
+          local.set $acc
+          local.get $start
+          i32.const 4
+          i32.add
+          local.set $start
+          br $loop
+        end
+      end
+      i32.const 0
+      local.get $acc
+      i64.atomic.rmw.add
+      drop))
+)";
+
+const uint32_t kPages = 256;
+const uint32_t kDataStart = 8;
+
+struct Worker {
+  Store store;
+  TypedFunc<std::tuple<int32_t, int32_t>, std::monostate> sum;
+
+  Worker(Engine &engine, const Module &module, const SharedMemory &memory)
+      : store(engine), sum(load(module, memory)) {}
+
+  TypedFunc<std::tuple<int32_t, int32_t>, std::monostate>
+  load(const Module &module, const SharedMemory &memory) {
+    ImportList imports;
+    imports.push_back(memory);
+    Instance i = Instance::create(store, module, imports).unwrap();
+    return std::get<Func>(*i.get(store, "sum"))
+        .typed<std::tuple<int32_t, int32_t>, std::monostate>(store)
+        .unwrap();
+  }
+};
+
+Engine threads_engine() {
+  Config config;
+  config.wasm_threads(true);
+  return Engine(std::move(config));
+}
+
+// Sums a fixed amount of data split over `state.range(0)` threads, each with
+// its own store and instance importing the same shared memory.
+void SharedMemorySum(benchmark::State &state) {
+  Engine engine = threads_engine();
+  Module module = Module::compile(engine, kSumWat).unwrap();
+  SharedMemory memory =
+      SharedMemory::create(engine, MemoryType::NewShared(kPages, kPages))
+          .unwrap();
+
+  size_t nthreads = state.range(0);
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (size_t i = 0; i < nthreads; i++) {
+    workers.push_back(std::make_unique<Worker>(engine, module, memory));
+  }
+
+  int32_t end = int32_t(memory.data().size());
+  int32_t chunk = (end - int32_t(kDataStart)) / int32_t(nthreads) & ~3;
+  for (auto _ : state) {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nthreads; i++) {
+      int32_t lo = int32_t(kDataStart) + int32_t(i) * chunk;
+      int32_t hi = i + 1 == nthreads ? end : lo + chunk;
+      threads.emplace_back([&, i, lo, hi] {
+        workers[i]->sum.call(workers[i]->store, {lo, hi}).unwrap();
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * (end - kDataStart));
+}
+BENCHMARK(SharedMemorySum)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
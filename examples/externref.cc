@@ -25,29 +25,29 @@ int main() {
   Instance instance = Instance::create(store, module, {}).unwrap();
 
   ExternRef externref(store, std::string("Hello, world!"));
-  std::any &data = externref.data(store);
+  std::any &data = *externref.data(store);
   std::cout << "externref data: " << std::any_cast<std::string>(data) << "\n";
 
   std::cout << "Touching `externref` table..\n";
   Table table = std::get<Table>(*instance.get(store, "table"));
   table.set(store, 3, externref).unwrap();
   ExternRef val = *table.get(store, 3)->externref(store);
-  std::cout << "externref data: " << std::any_cast<std::string>(val.data(store))
-            << "\n";
+  std::cout << "externref data: "
+            << std::any_cast<std::string>(*val.data(store)) << "\n";
 
   std::cout << "Touching `externref` global..\n";
   Global global = std::get<Global>(*instance.get(store, "global"));
   global.set(store, externref).unwrap();
   val = *global.get(store).externref(store);
-  std::cout << "externref data: " << std::any_cast<std::string>(val.data(store))
-            << "\n";
+  std::cout << "externref data: "
+            << std::any_cast<std::string>(*val.data(store)) << "\n";
 
   std::cout << "Calling `externref` func..\n";
   Func func = std::get<Func>(*instance.get(store, "func"));
   auto results = func.call(store, {externref}).unwrap();
   val = *results[0].externref(store);
-  std::cout << "externref data: " << std::any_cast<std::string>(val.data(store))
-            << "\n";
+  std::cout << "externref data: "
+            << std::any_cast<std::string>(*val.data(store)) << "\n";
 
   std::cout << "Running a gc..\n";
   store.context().gc();
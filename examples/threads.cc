@@ -0,0 +1,80 @@
+/*
+Example of sharing one linear memory between several threads.
+
+The host fills a `SharedMemory` with data and then spawns worker threads. Each
+worker has its own `Store` and instance of the same module, all importing the
+same shared memory, and sums its own slice of the data into a shared atomic
+accumulator.
+*/
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <wasmtime.hh>
+
+using namespace wasmtime;
+
+std::string readFile(const char *name) {
+  std::ifstream watFile;
+  watFile.open(name);
+  std::stringstream strStream;
+  strStream << watFile.rdbuf();
+  return strStream.str();
+}
+
+const uint32_t kWorkers = 4;
+const uint32_t kValues = 10000;
+// The accumulator lives at address 0, so data starts after it.
+const uint32_t kDataStart = 8;
+
+int main() {
+  Config config;
+  config.wasm_threads(true);
+  Engine engine(std::move(config));
+  Module module =
+      Module::compile(engine, readFile("examples/threads.wat")).unwrap();
+
+  // Create the memory shared by all workers and fill it with 1..=kValues.
+  SharedMemory memory =
+      SharedMemory::create(engine, MemoryType::NewShared(1, 16)).unwrap();
+  auto data = memory.data();
+  for (uint32_t i = 0; i < kValues; i++) {
+    uint32_t value = i + 1;
+    memcpy(&data[kDataStart + i * 4], &value, sizeof(value));
+  }
+
+  std::cout << "Summing " << kValues << " values on " << kWorkers
+            << " threads...\n";
+  std::vector<std::thread> workers;
+  for (uint32_t w = 0; w < kWorkers; w++) {
+    workers.emplace_back([&, w] {
+      // Every worker gets its own store, but imports the same memory.
+      Store store(engine);
+      ImportList imports;
+      imports.push_back(memory);
+      Instance instance = Instance::create(store, module, imports).unwrap();
+      auto sum = std::get<Func>(*instance.get(store, "sum"))
+                     .typed<std::tuple<int32_t, int32_t>, std::monostate>(store)
+                     .unwrap();
+      int32_t chunk = kValues / kWorkers;
+      int32_t start = kDataStart + w * chunk * 4;
+      int32_t end =
+          w + 1 == kWorkers ? kDataStart + kValues * 4 : start + chunk * 4;
+      sum.call(store, {start, end}).unwrap();
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  uint64_t total = 0;
+  memcpy(&total, &data[0], sizeof(total));
+  std::cout << "Total: " << total << "\n";
+  if (total != uint64_t(kValues) * (kValues + 1) / 2) {
+    std::cerr << "wrong total\n";
+    return 1;
+  }
+}
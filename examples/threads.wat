@@ -0,0 +1,30 @@
+(module
+  (import "env" "memory" (memory 1 16 shared))
+
+  ;; Sums the 32-bit unsigned integers in the byte range [start, end) and
+  ;; atomically adds the total to the 64-bit accumulator at address 0.
+  (func (export "sum") (param $start i32) (param $end i32)
+    (local $acc i64)
+    block $done
+      loop $loop
+        local.get $start
+        local.get $end
+        i32.ge_u
+        br_if $done
+        local.get $acc
+        local.get $start
+        i64.load32_u
+        i64.add
+        local.set $acc
+        local.get $start
+        i32.const 4
+        i32.add
+        local.set $start
+        br $loop
+      end
+    end
+    i32.const 0
+    local.get $acc
+    i64.atomic.rmw.add
+    drop)
+)
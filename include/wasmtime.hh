@@ -23,6 +23,7 @@
  * \example memory.cc
  * \example interrupt.cc
  * \example externref.cc
+ * \example threads.cc
  */
 
 /**
@@ -32,15 +33,29 @@
 #ifndef WASMTIME_HH
 #define WASMTIME_HH
 
+#include <algorithm>
 #include <any>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <exception>
+#include <functional>
 #include <initializer_list>
 #include <iosfwd>
 #include <limits>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
 #include <ostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 #ifdef __has_include
@@ -48,11 +63,40 @@
 #include <span>
 #endif
 #endif
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "wasmtime.h"
 
+/// \brief Defined when the coroutine-based async API (`Linker::func_new_async`,
+/// `Linker::func_wrap_async`, and awaiting a `CallFuture`) is available.
+///
+/// This requires both a C API built with async support and a compiler with
+/// C++20 coroutines.
+#if defined(WASMTIME_FEATURE_ASYNC) && defined(__cpp_impl_coroutine) &&        \
+    defined(__cpp_lib_coroutine)
+#define WASMTIME_CPP_COROUTINES
+#endif
+
 namespace wasmtime {
 
+// Defining `WASMTIME_CPP_HOST_PROFILING` changes the bodies of inline
+// functions such as `Linker::func_new`. Everything is placed in a distinct
+// inline namespace in that mode so that translation units built with and
+// without it don't silently share differing definitions: mixing them is a
+// link error instead of an ODR violation.
+#ifdef WASMTIME_CPP_HOST_PROFILING
+inline namespace host_profiling {
+#endif
+
 #ifdef __cpp_lib_span
 
 /// \brief Alias to C++20 std::span when it is available
@@ -141,6 +185,8 @@ class Trace;
  * description of the error that occurred.
  */
 class Error {
+  friend class Store;
+
   struct deleter {
     void operator()(wasmtime_error_t *p) const { wasmtime_error_delete(p); }
   };
@@ -257,6 +303,301 @@ enum class ProfilingStrategy {
   Vtune = WASMTIME_PROFILING_STRATEGY_VTUNE,
 };
 
+#ifdef WASMTIME_FEATURE_POOLING_ALLOCATOR
+/**
+ * \brief Configuration for Wasmtime's pooling instance allocator.
+ *
+ * The pooling allocator preallocates slots for instances, linear memories,
+ * and tables up front and reuses them, which makes instantiation much cheaper
+ * than mapping and unmapping fresh memory for every instance. It's enabled
+ * with `Config::pooling_allocation_strategy`.
+ *
+ * For more information be sure to consult the [rust
+ * documentation](https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html).
+ */
+class PoolingAllocationConfig {
+  friend class Config;
+
+  struct deleter {
+    void operator()(wasmtime_pooling_allocation_config_t *p) const {
+      wasmtime_pooling_allocation_config_delete(p);
+    }
+  };
+
+  std::unique_ptr<wasmtime_pooling_allocation_config_t, deleter> ptr;
+
+public:
+  /// \brief Creates pooling configuration with all the default settings.
+  PoolingAllocationConfig() : ptr(wasmtime_pooling_allocation_config_new()) {}
+
+  /// \brief Configures the maximum number of "unused warm slots"
+  /// to retain in the pooling allocator.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_unused_warm_slots
+  void max_unused_warm_slots(uint32_t count) {
+    wasmtime_pooling_allocation_config_max_unused_warm_slots_set(
+        ptr.get(), count);
+  }
+
+  /// \brief Configures how many slots are decommitted at once when they are
+  /// returned to the pool.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.decommit_batch_size
+  void decommit_batch_size(size_t size) {
+    wasmtime_pooling_allocation_config_decommit_batch_size_set(ptr.get(), size);
+  }
+
+  /// \brief Configures how many bytes of async stacks are kept resident between
+  /// uses.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.async_stack_keep_resident
+  void async_stack_keep_resident(size_t size) {
+    wasmtime_pooling_allocation_config_async_stack_keep_resident_set(
+        ptr.get(), size);
+  }
+
+  /// \brief Configures how many bytes of linear memory are kept resident,
+  /// rather than decommitted, when a memory slot is returned to the pool.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.linear_memory_keep_resident
+  void linear_memory_keep_resident(size_t size) {
+    wasmtime_pooling_allocation_config_linear_memory_keep_resident_set(
+        ptr.get(), size);
+  }
+
+  /// \brief Configures how many bytes of tables are kept resident, rather than
+  /// decommitted, when a table slot is returned to the pool.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.table_keep_resident
+  void table_keep_resident(size_t size) {
+    wasmtime_pooling_allocation_config_table_keep_resident_set(ptr.get(), size);
+  }
+
+  /// \brief Configures the maximum number of concurrent component instances.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.total_component_instances
+  void total_component_instances(uint32_t count) {
+    wasmtime_pooling_allocation_config_total_component_instances_set(
+        ptr.get(), count);
+  }
+
+  /// \brief Configures the maximum size, in bytes, of a component instance's
+  /// metadata.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_component_instance_size
+  void max_component_instance_size(size_t size) {
+    wasmtime_pooling_allocation_config_max_component_instance_size_set(
+        ptr.get(), size);
+  }
+
+  /// \brief Configures the maximum number of core instances a component may
+  /// contain.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_core_instances_per_component
+  void max_core_instances_per_component(uint32_t count) {
+    wasmtime_pooling_allocation_config_max_core_instances_per_component_set(
+        ptr.get(), count);
+  }
+
+  /// \brief Configures the maximum number of linear memories a component may
+  /// contain.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_memories_per_component
+  void max_memories_per_component(uint32_t count) {
+    wasmtime_pooling_allocation_config_max_memories_per_component_set(
+        ptr.get(), count);
+  }
+
+  /// \brief Configures the maximum number of tables a component may contain.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_tables_per_component
+  void max_tables_per_component(uint32_t count) {
+    wasmtime_pooling_allocation_config_max_tables_per_component_set(
+        ptr.get(), count);
+  }
+
+  /// \brief Configures the total number of linear memories that can be
+  /// allocated concurrently.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.total_memories
+  void total_memories(uint32_t count) {
+    wasmtime_pooling_allocation_config_total_memories_set(ptr.get(), count);
+  }
+
+  /// \brief Configures the total number of tables that can be allocated
+  /// concurrently.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.total_tables
+  void total_tables(uint32_t count) {
+    wasmtime_pooling_allocation_config_total_tables_set(ptr.get(), count);
+  }
+
+  /// \brief Configures the total number of async stacks that can be allocated
+  /// concurrently.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.total_stacks
+  void total_stacks(uint32_t count) {
+    wasmtime_pooling_allocation_config_total_stacks_set(ptr.get(), count);
+  }
+
+  /// \brief Configures the total number of core instances that can be allocated
+  /// concurrently.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.total_core_instances
+  void total_core_instances(uint32_t count) {
+    wasmtime_pooling_allocation_config_total_core_instances_set(
+        ptr.get(), count);
+  }
+
+  /// \brief Configures the maximum size, in bytes, of a core instance's
+  /// metadata.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_core_instance_size
+  void max_core_instance_size(size_t size) {
+    wasmtime_pooling_allocation_config_max_core_instance_size_set(
+        ptr.get(), size);
+  }
+
+  /// \brief Configures the maximum number of tables a core module may define.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_tables_per_module
+  void max_tables_per_module(uint32_t count) {
+    wasmtime_pooling_allocation_config_max_tables_per_module_set(
+        ptr.get(), count);
+  }
+
+  /// \brief Configures the maximum number of elements in each table.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.table_elements
+  void table_elements(size_t size) {
+    wasmtime_pooling_allocation_config_table_elements_set(ptr.get(), size);
+  }
+
+  /// \brief Configures the maximum number of linear memories a core module may
+  /// define.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_memories_per_module
+  void max_memories_per_module(uint32_t count) {
+    wasmtime_pooling_allocation_config_max_memories_per_module_set(
+        ptr.get(), count);
+  }
+
+  /// \brief Configures the maximum size, in bytes, of each linear memory.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.max_memory_size
+  void max_memory_size(size_t size) {
+    wasmtime_pooling_allocation_config_max_memory_size_set(ptr.get(), size);
+  }
+
+  /// \brief Configures the total number of GC heaps that can be allocated
+  /// concurrently.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.PoolingAllocationConfig.html#method.total_gc_heaps
+  void total_gc_heaps(uint32_t count) {
+    wasmtime_pooling_allocation_config_total_gc_heaps_set(ptr.get(), count);
+  }
+};
+#endif // WASMTIME_FEATURE_POOLING_ALLOCATOR
+
+/**
+ * \brief Host-side admission control for linear memories and tables.
+ *
+ * A `ResourceLimiter` installed on a store with `Store::resource_limiter` is
+ * consulted before that store creates or grows a memory or table through this
+ * library: `Memory::create`, `Memory::grow`, `Table::create`, and
+ * `Table::grow`. Unlike `Store::limiter`, which applies fixed caps to a single
+ * store, a limiter can make decisions based on state shared between many
+ * stores, for example a budget for the whole process. Everything a limiter
+ * allowed for a store is given back through `memory_released` and
+ * `table_released` once that store is destroyed.
+ *
+ * Wasmtime's C API doesn't expose a growth callback, so memories and tables
+ * created by instantiation or grown by WebAssembly's own `memory.grow` and
+ * `table.grow` are not seen by the limiter. Bound those per store with
+ * `Store::limiter`.
+ *
+ * A limiter shared between stores on several threads must be thread-safe.
+ */
+class ResourceLimiter {
+public:
+  virtual ~ResourceLimiter() = default;
+
+  /// \brief Invoked when a linear memory is about to grow from `current` to
+  /// `desired` bytes, returning whether the growth is allowed.
+  ///
+  /// A memory being created grows from a `current` of zero to its minimum
+  /// size. `maximum` is the memory's declared maximum in bytes, if any.
+  virtual bool memory_growing(size_t current, size_t desired,
+                              std::optional<size_t> maximum) = 0;
+
+  /// \brief Invoked when a table is about to grow from `current` to `desired`
+  /// elements, returning whether the growth is allowed.
+  ///
+  /// A table being created grows from a `current` of zero to its minimum
+  /// size. `maximum` is the table's declared maximum, if any. By default all
+  /// table growth is allowed.
+  virtual bool table_growing(uint64_t /*current*/, uint64_t /*desired*/,
+                             std::optional<uint64_t> /*maximum*/) {
+    return true;
+  }
+
+  /// \brief Invoked with the number of memory bytes given back once a store
+  /// is destroyed, or when a growth which was allowed couldn't be completed.
+  virtual void memory_released(size_t /*bytes*/) {}
+
+  /// \brief Invoked with the number of table elements given back once a
+  /// store is destroyed, or when a growth which was allowed couldn't be
+  /// completed.
+  virtual void table_released(uint64_t /*elements*/) {}
+};
+
+/**
+ * \brief A `ResourceLimiter` enforcing one budget of linear memory bytes
+ * across all memories it's consulted for.
+ *
+ * The budget is tracked with a single atomic counter, so many stores on many
+ * threads can share a limiter without taking locks. Tables aren't limited.
+ */
+class SharedBudgetLimiter : public ResourceLimiter {
+  size_t budget_;
+  std::atomic<size_t> used_{0};
+
+public:
+  /// Creates a limiter allowing `budget` bytes of linear memory in total.
+  explicit SharedBudgetLimiter(size_t budget) : budget_(budget) {}
+
+  /// Reserves `desired - current` bytes if that fits in the budget.
+  bool memory_growing(size_t current, size_t desired,
+                      std::optional<size_t> maximum) override {
+    if (maximum && desired > *maximum) {
+      return false;
+    }
+    size_t delta = desired - current;
+    size_t used = used_.load(std::memory_order_relaxed);
+    do {
+      if (delta > budget_ - used) {
+        return false;
+      }
+    } while (!used_.compare_exchange_weak(used, used + delta,
+                                          std::memory_order_relaxed));
+    return true;
+  }
+
+  /// Returns `bytes` to the budget.
+  void memory_released(size_t bytes) override {
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  /// Returns the total budget in bytes.
+  size_t budget() const { return budget_; }
+
+  /// Returns the number of bytes currently allocated from the budget.
+  size_t used() const { return used_.load(std::memory_order_relaxed); }
+
+  /// Returns the number of bytes still available.
+  size_t available() const { return budget_ - used(); }
+};
+
 /**
  * \brief Configuration for Wasmtime.
  *
@@ -303,6 +644,24 @@ public:
     wasmtime_config_consume_fuel_set(ptr.get(), enable);
   }
 
+#ifdef WASMTIME_FEATURE_ASYNC
+  /// \brief Configures whether async support is enabled, which is required to
+  /// use `Func::call_async`, `Linker::instantiate_async`, and async host
+  /// functions.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.async_support
+  void async_support(bool enable) {
+    wasmtime_config_async_support_set(ptr.get(), enable);
+  }
+
+  /// \brief Configures the size of the stacks used for asynchronous execution.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.async_stack_size
+  void async_stack_size(uint64_t size) {
+    wasmtime_config_async_stack_size_set(ptr.get(), size);
+  }
+#endif // WASMTIME_FEATURE_ASYNC
+
   /// \brief Configures the maximum amount of native stack wasm can consume.
   ///
   /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.max_wasm_stack
@@ -390,6 +749,42 @@ public:
         ptr.get(), static_cast<wasmtime_opt_level_t>(level));
   }
 
+  /// \brief Configures the target triple code is compiled for, such as
+  /// `x86_64-unknown-linux-gnu`, for cross-compilation with
+  /// `Engine::precompile`.
+  ///
+  /// Returns an error if the triple isn't recognized or supported.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.target
+  Result<std::monostate> target(const std::string &triple) {
+    auto *error = wasmtime_config_target_set(ptr.get(), triple.c_str());
+    if (error != nullptr) {
+      return Error(error);
+    }
+    return std::monostate();
+  }
+
+  /// \brief Enables the boolean Cranelift setting `flag`, for example a CPU
+  /// feature such as `has_avx2`.
+  ///
+  /// Settings aren't checked here, and the C API offers no fallible way to
+  /// create an `Engine`: creating one from a configuration with an unknown or
+  /// invalid setting aborts the process.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.cranelift_flag_enable
+  void cranelift_flag_enable(const std::string &flag) {
+    wasmtime_config_cranelift_flag_enable(ptr.get(), flag.c_str());
+  }
+
+  /// \brief Sets the Cranelift setting `name` to `value`.
+  ///
+  /// Settings aren't checked here, see `cranelift_flag_enable`.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.cranelift_flag_set
+  void cranelift_flag_set(const std::string &name, const std::string &value) {
+    wasmtime_config_cranelift_flag_set(ptr.get(), name.c_str(), value.c_str());
+  }
+
   /// \brief Configures an active wasm profiler
   ///
   /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.profiler
@@ -412,6 +807,24 @@ public:
     wasmtime_config_memory_guard_size_set(ptr.get(), size);
   }
 
+  /// \brief Configures whether linear memories are initialized from a
+  /// copy-on-write image of the module's data segments.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.memory_init_cow
+  void memory_init_cow(bool enable) {
+    wasmtime_config_memory_init_cow_set(ptr.get(), enable);
+  }
+
+#ifdef WASMTIME_FEATURE_POOLING_ALLOCATOR
+  /// \brief Enables the pooling instance allocator with the settings in
+  /// `config`.
+  ///
+  /// https://docs.wasmtime.dev/api/wasmtime/enum.InstanceAllocationStrategy.html#variant.Pooling
+  void pooling_allocation_strategy(const PoolingAllocationConfig &config) {
+    wasmtime_pooling_allocation_strategy_set(ptr.get(), config.ptr.get());
+  }
+#endif // WASMTIME_FEATURE_POOLING_ALLOCATOR
+
   /// \brief Loads the default cache configuration present on the system.
   ///
   /// https://docs.wasmtime.dev/api/wasmtime/struct.Config.html#method.cache_config_load_default
@@ -435,6 +848,8 @@ public:
   }
 };
 
+class ByteVec;
+
 /**
  * \brief Global compilation state in Wasmtime.
  *
@@ -446,12 +861,23 @@ class Engine {
   friend class Store;
   friend class Module;
   friend class Linker;
+  friend class SharedMemory;
+  friend class ModuleCache;
 
   struct deleter {
     void operator()(wasm_engine_t *p) const { wasm_engine_delete(p); }
   };
 
+  // Computed by the first `ModuleCache` created for this engine and shared by
+  // all later ones.
+  struct Fingerprint {
+    std::once_flag once;
+    std::string digest;
+    std::optional<std::string> error;
+  };
+
   std::unique_ptr<wasm_engine_t, deleter> ptr;
+  std::unique_ptr<Fingerprint> fingerprint = std::make_unique<Fingerprint>();
 
 public:
   /// \brief Creates an engine with default compilation settings.
@@ -464,6 +890,19 @@ public:
   /// currently executing WebAssembly in connected stores if the epoch is now
   /// beyond the configured threshold.
   void increment_epoch() const { wasmtime_engine_increment_epoch(ptr.get()); }
+
+  /**
+   * \brief Compiles `wasm` ahead of time into an artifact loadable with
+   * `Module::deserialize` or `Module::deserialize_file`.
+   *
+   * Code is generated for this engine's configuration, including any
+   * `Config::target` and Cranelift settings, so this engine doesn't need to
+   * be able to run it. The artifact is only compatible with engines using
+   * the same configuration and version of Wasmtime.
+   *
+   * https://docs.wasmtime.dev/api/wasmtime/struct.Engine.html#method.precompile_module
+   */
+  Result<ByteVec> precompile(Span<uint8_t> wasm) const;
 };
 
 /**
@@ -652,6 +1091,7 @@ public:
  */
 class MemoryType {
   friend class Memory;
+  friend class SharedMemory;
 
   struct deleter {
     void operator()(wasm_memorytype_t *p) const { wasm_memorytype_delete(p); }
@@ -719,6 +1159,12 @@ public:
     return MemoryType(wasmtime_memorytype_new(min, true, max, true, false));
   }
 
+  /// Creates a new 32-bit shared memory type, for use with `SharedMemory`.
+  /// Shared memories must have a maximum size.
+  static MemoryType NewShared(uint32_t min, uint32_t max) {
+    return MemoryType(wasmtime_memorytype_new(min, true, max, false, true));
+  }
+
   /// Creates a new wasm memory type from the specified ref, making a fresh
   /// owned value.
   MemoryType(Ref other) : MemoryType(wasm_memorytype_copy(other.ptr)) {}
@@ -1285,9 +1731,12 @@ inline Trace Error::trace() const {
  * frames on the stack.
  */
 class Trap {
+  template <typename T> friend class CallFuture;
   friend class Linker;
   friend class Instance;
+  friend class InstancePre;
   friend class Func;
+  friend class PreparedCall;
   template <typename Params, typename Results> friend class TypedFunc;
 
   struct deleter {
@@ -1348,6 +1797,71 @@ struct TrapError {
 /// (such as a type error) as well as because of a WebAssembly trap.
 template <typename T> using TrapResult = Result<T, TrapError>;
 
+/// Error returned by `TypedFunc::call_many` when one call in a batch fails.
+struct CallManyError {
+  /// Index, within the batch, of the call which failed.
+  size_t index;
+  /// The trap or error produced by that call.
+  TrapError error;
+
+  /// Returns the message associated with the underlying error.
+  std::string message() const { return error.message(); }
+};
+
+/**
+ * \brief An owned list of bytes allocated by Wasmtime.
+ *
+ * This wraps a `wasm_byte_vec_t` returned from the C API and frees it when
+ * destroyed, which allows large buffers such as serialized modules to be
+ * handed out without copying them into a `std::vector`.
+ */
+class ByteVec {
+  wasm_byte_vec_t vec;
+
+public:
+  /// Creates an empty list
+  ByteVec() : vec{} {
+    vec.size = 0;
+    vec.data = nullptr;
+  }
+  /// Takes ownership of the raw C API representation of a list of bytes.
+  explicit ByteVec(wasm_byte_vec_t vec) : vec(vec) {}
+  ByteVec(const ByteVec &other) = delete;
+  /// Moves another list into this one.
+  ByteVec(ByteVec &&other) noexcept : vec(other.vec) { other.vec.size = 0; }
+  ~ByteVec() {
+    if (vec.size > 0) {
+      wasm_byte_vec_delete(&vec);
+    }
+  }
+
+  ByteVec &operator=(const ByteVec &other) = delete;
+  /// Moves another list into this one.
+  ByteVec &operator=(ByteVec &&other) noexcept {
+    std::swap(vec, other.vec);
+    return *this;
+  }
+
+  /// Returns a pointer to the start of these bytes.
+  uint8_t *data() const {
+    return reinterpret_cast<uint8_t *>(vec.data); // NOLINT
+  }
+  /// Returns the number of bytes in this list.
+  size_t size() const { return vec.size; }
+  /// Returns a `Span` over these bytes.
+  Span<uint8_t> span() const { return {data(), size()}; }
+};
+
+inline Result<ByteVec> Engine::precompile(Span<uint8_t> wasm) const {
+  wasm_byte_vec_t out;
+  auto *error = wasmtime_engine_precompile_module(ptr.get(), wasm.data(),
+                                                  wasm.size(), &out);
+  if (error != nullptr) {
+    return Error(error);
+  }
+  return ByteVec(out);
+}
+
 /**
  * \brief Representation of a compiled WebAssembly module.
  *
@@ -1358,7 +1872,9 @@ template <typename T> using TrapResult = Result<T, TrapError>;
  */
 class Module {
   friend class Store;
+  friend class GuestProfiler;
   friend class Instance;
+  friend class InstancePre;
   friend class Linker;
 
   struct deleter {
@@ -1418,6 +1934,125 @@ public:
     return Module(ret);
   }
 
+  /// \brief Options for `compile_many`.
+  struct CompileManyOptions {
+    /// Number of worker threads to compile with, or 0 to use one per
+    /// hardware thread. Never more than the number of modules.
+    size_t threads = 0;
+    /// Invoked after each module finishes, with the number of modules
+    /// finished so far and the total. Calls come from worker threads but are
+    /// never concurrent with each other.
+    std::function<void(size_t finished, size_t total)> progress;
+    /// When set to `true`, modules which haven't started compiling yet are
+    /// skipped and fail with an error. Compilations already in progress run
+    /// to completion.
+    const std::atomic<bool> *cancel = nullptr;
+  };
+
+  /**
+   * \brief Compiles each of `wasms` on a pool of worker threads sharing
+   * `engine`.
+   *
+   * This is the same as calling `compile` for each binary, in parallel. The
+   * results are in the same order as `wasms`; one module failing doesn't
+   * affect the others. This complements `Config::parallel_compilation`, which
+   * parallelizes within each module.
+   *
+   * If `options.progress` throws, or a worker thread can't be started, the
+   * remaining modules are skipped and the first exception is rethrown once
+   * all workers have been joined.
+   */
+  static std::vector<Result<Module>>
+  compile_many(Engine &engine, Span<const Span<uint8_t>> wasms,
+               const CompileManyOptions &options) {
+    size_t total = wasms.size();
+    std::vector<std::optional<Result<Module>>> slots(total);
+    std::atomic<size_t> next{0};
+    size_t finished = 0;
+    std::mutex progress_lock;
+    // The first exception thrown on any thread, after which the remaining
+    // modules are skipped.
+    std::exception_ptr failure;
+    std::atomic<bool> failed{false};
+    auto fail = [&](std::exception_ptr e) {
+      std::lock_guard<std::mutex> guard(progress_lock);
+      if (!failure) {
+        failure = std::move(e);
+      }
+      failed.store(true, std::memory_order_relaxed);
+    };
+
+    auto worker = [&] {
+      try {
+        while (!failed.load(std::memory_order_relaxed)) {
+          size_t i = next.fetch_add(1, std::memory_order_relaxed);
+          if (i >= total) {
+            return;
+          }
+          if (options.cancel != nullptr &&
+              options.cancel->load(std::memory_order_relaxed)) {
+            slots[i] = Error(wasmtime_error_new("compilation cancelled"));
+          } else {
+            slots[i] = compile(engine, wasms[i]);
+          }
+          std::lock_guard<std::mutex> guard(progress_lock);
+          finished++;
+          if (options.progress) {
+            options.progress(finished, total);
+          }
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+    };
+
+    size_t threads = options.threads;
+    if (threads == 0) {
+      threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    threads = std::min(threads, total);
+    {
+      std::vector<std::thread> pool;
+      struct Joiner {
+        std::vector<std::thread> &pool;
+        ~Joiner() {
+          for (auto &thread : pool) {
+            thread.join();
+          }
+        }
+      } joiner{pool};
+      try {
+        pool.reserve(threads);
+        for (size_t n = 1; n < threads; n++) {
+          pool.emplace_back(worker);
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+      // The calling thread is one of the workers.
+      if (total > 0) {
+        worker();
+      }
+    }
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+
+    std::vector<Result<Module>> ret;
+    ret.reserve(total);
+    for (auto &slot : slots) {
+      ret.push_back(std::move(*slot));
+    }
+    return ret;
+  }
+
+  /// \brief Compiles each of `wasms` in parallel with the default
+  /// `CompileManyOptions`.
+  static std::vector<Result<Module>>
+  compile_many(Engine &engine, Span<const Span<uint8_t>> wasms) {
+    return compile_many(engine, wasms, CompileManyOptions());
+  }
+
   /**
    * \brief Validates the provided WebAssembly binary without compiling it.
    *
@@ -1440,6 +2075,12 @@ public:
    * the artifacts of a previous compilation to quickly create an in-memory
    * module ready for instantiation.
    *
+   * Wasmtime copies what it needs out of `wasm` before this returns, so the
+   * bytes may be freed or unmapped right afterwards. For example, a region of
+   * a memory-mapped bundle of artifacts can be passed directly. For an
+   * artifact stored in its own file, `deserialize_file` is usually faster as
+   * Wasmtime maps the file itself.
+   *
    * It is not safe to pass arbitrary input to this function, it is only safe to
    * pass in output from previous calls to `serialize`. For more information see
    * the Rust documentation -
@@ -1499,53 +2140,640 @@ public:
    * quickly recreate this module in a different process perhaps.
    */
   Result<std::vector<uint8_t>> serialize() const {
+    auto bytes = serialize_bytes();
+    if (!bytes) {
+      return bytes.err();
+    }
+    auto raw = bytes.ok().span();
+    return std::vector<uint8_t>(raw.begin(), raw.end());
+  }
+
+  /**
+   * \brief Serializes this module into a buffer owned by Wasmtime.
+   *
+   * This is the same as `serialize` except that the bytes produced by
+   * Wasmtime are returned directly instead of being copied into a
+   * `std::vector`, which avoids doubling peak memory usage for large modules.
+   */
+  Result<ByteVec> serialize_bytes() const {
     wasm_byte_vec_t bytes;
     auto *error = wasmtime_module_serialize(ptr.get(), &bytes);
     if (error != nullptr) {
       return Error(error);
     }
-    std::vector<uint8_t> ret;
-    // NOLINTNEXTLINE TODO can this be done without triggering lints?
-    Span<uint8_t> raw(reinterpret_cast<uint8_t *>(bytes.data), bytes.size);
-    ret.assign(raw.begin(), raw.end());
-    wasm_byte_vec_delete(&bytes);
-    return ret;
+    return ByteVec(bytes);
   }
-};
 
-/**
- * \brief Configuration for an instance of WASI.
- *
- * This is inserted into a store with `Store::Context::set_wasi`.
- */
-class WasiConfig {
-  friend class Store;
+  /**
+   * \brief Serializes this module and writes it to `os`.
+   *
+   * The serialized bytes are written straight from Wasmtime's buffer and are
+   * not copied. Returns an error if serialization or writing fails.
+   */
+  Result<std::monostate> serialize_to(std::ostream &os) const {
+    auto bytes = serialize_bytes();
+    if (!bytes) {
+      return bytes.err();
+    }
+    auto raw = bytes.ok().span();
+    os.write(reinterpret_cast<const char *>(raw.data()), // NOLINT
+             static_cast<std::streamsize>(raw.size()));
+    if (!os) {
+      return Error(wasmtime_error_new("failed to write serialized module"));
+    }
+    return std::monostate();
+  }
 
-  struct deleter {
-    void operator()(wasi_config_t *p) const { wasi_config_delete(p); }
-  };
+  /**
+   * \brief Serializes this module and writes it to `file`.
+   *
+   * The serialized bytes are written straight from Wasmtime's buffer and are
+   * not copied. A `FILE` for an existing file descriptor can be created with
+   * `fdopen`. Returns an error if serialization or writing fails.
+   */
+  Result<std::monostate> serialize_to(FILE *file) const {
+    auto bytes = serialize_bytes();
+    if (!bytes) {
+      return bytes.err();
+    }
+    auto raw = bytes.ok().span();
+    if (::fwrite(raw.data(), 1, raw.size(), file) != raw.size()) {
+      return Error(wasmtime_error_new("failed to write serialized module"));
+    }
+    return std::monostate();
+  }
 
-  std::unique_ptr<wasi_config_t, deleter> ptr;
+  /// Returns the size, in bytes, of the compiled code image of this module.
+  ///
+  /// This can be used as an estimate of the memory retained by keeping this
+  /// module alive.
+  size_t image_size() const {
+    void *start = nullptr;
+    void *end = nullptr;
+    wasmtime_module_image_range(ptr.get(), &start, &end);
+    return static_cast<uint8_t *>(end) - static_cast<uint8_t *>(start);
+  }
+};
 
-public:
-  /// Creates a new configuration object with default settings.
-  WasiConfig() : ptr(wasi_config_new()) {}
+namespace detail {
 
-  /// Configures the argv explicitly with the given string array.
-  void argv(const std::vector<std::string> &args) {
-    std::vector<const char *> ptrs;
-    ptrs.reserve(args.size());
-    for (const auto &arg : args) {
-      ptrs.push_back(arg.c_str());
+/// Incremental SHA-256 implementation used to key content-addressed caches
+/// of modules.
+class Sha256 {
+  std::array<uint32_t, 8> state = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                   0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                   0x1f83d9ab, 0x5be0cd19};
+  std::array<uint8_t, 64> buf = {};
+  size_t buf_len = 0;
+  uint64_t total_len = 0;
+
+  static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+  void block(const uint8_t *p) {
+    static constexpr std::array<uint32_t, 64> k = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+        0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+        0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+        0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    std::array<uint32_t, 64> w = {};
+    for (size_t i = 0; i < 16; i++) {
+      w[i] = uint32_t(p[i * 4]) << 24 | uint32_t(p[i * 4 + 1]) << 16 | // NOLINT
+             uint32_t(p[i * 4 + 2]) << 8 | uint32_t(p[i * 4 + 3]);     // NOLINT
+    }
+    for (size_t i = 16; i < 64; i++) {
+      uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    auto v = state;
+    for (size_t i = 0; i < 64; i++) {
+      uint32_t s1 = rotr(v[4], 6) ^ rotr(v[4], 11) ^ rotr(v[4], 25);
+      uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+      uint32_t t1 = v[7] + s1 + ch + k[i] + w[i];
+      uint32_t s0 = rotr(v[0], 2) ^ rotr(v[0], 13) ^ rotr(v[0], 22);
+      uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+      v = {t1 + s0 + maj, v[0], v[1], v[2], v[3] + t1, v[4], v[5], v[6]};
+    }
+    for (size_t i = 0; i < 8; i++) {
+      state[i] += v[i];
     }
-
-    wasi_config_set_argv(ptr.get(), (int)args.size(), ptrs.data());
   }
 
-  /// Configures the argv for wasm to be inherited from this process itself.
-  void inherit_argv() { wasi_config_inherit_argv(ptr.get()); }
+public:
+  /// Size, in bytes, of a digest.
+  static constexpr size_t digest_size = 32;
+
+  /// Feeds `len` more bytes at `data` into this hash.
+  void update(const uint8_t *data, size_t len) {
+    total_len += len;
+    if (buf_len > 0) {
+      size_t n = std::min(len, buf.size() - buf_len);
+      memcpy(&buf[buf_len], data, n);
+      buf_len += n;
+      data += n; // NOLINT
+      len -= n;
+      if (buf_len < buf.size()) {
+        return;
+      }
+      block(buf.data());
+      buf_len = 0;
+    }
+    for (; len >= buf.size(); len -= buf.size()) {
+      block(data);
+      data += buf.size(); // NOLINT
+    }
+    if (len > 0) {
+      memcpy(buf.data(), data, len);
+    }
+    buf_len = len;
+  }
 
-  /// Configures the environment variables available to wasm, specified here as
+  /// Finishes hashing and returns the digest of all bytes fed so far.
+  std::array<uint8_t, digest_size> finish() {
+    uint64_t bits = total_len * 8;
+    const uint8_t pad = 0x80;
+    update(&pad, 1);
+    const uint8_t zero = 0;
+    while (buf_len != 56) {
+      update(&zero, 1);
+    }
+    std::array<uint8_t, 8> len_be = {};
+    for (size_t i = 0; i < 8; i++) {
+      len_be[i] = uint8_t(bits >> (56 - i * 8));
+    }
+    update(len_be.data(), len_be.size());
+    std::array<uint8_t, digest_size> out = {};
+    for (size_t i = 0; i < 8; i++) {
+      out[i * 4] = uint8_t(state[i] >> 24);
+      out[i * 4 + 1] = uint8_t(state[i] >> 16);
+      out[i * 4 + 2] = uint8_t(state[i] >> 8);
+      out[i * 4 + 3] = uint8_t(state[i]);
+    }
+    return out;
+  }
+
+  /// Returns the lowercase hexadecimal representation of a digest.
+  static std::string hex(const std::array<uint8_t, digest_size> &digest) {
+    static const char *digits = "0123456789abcdef";
+    std::string ret;
+    ret.reserve(digest.size() * 2);
+    for (auto byte : digest) {
+      ret.push_back(digits[byte >> 4]);  // NOLINT
+      ret.push_back(digits[byte & 15]); // NOLINT
+    }
+    return ret;
+  }
+};
+
+} // namespace detail
+
+/**
+ * \brief An in-process cache of compiled modules keyed by their contents.
+ *
+ * A `ModuleCache` sits in front of `Module::compile` for embeddings which
+ * repeatedly compile the same WebAssembly binaries. Modules are keyed by the
+ * SHA-256 of the wasm bytes combined with a fingerprint of the `Engine`'s
+ * compilation settings, so a cache is only ever shared between compatible
+ * compilations.
+ *
+ * The cache has two tiers:
+ *
+ * * An in-memory tier holding recently used `Module`s. Its total size, as
+ *   measured by `Module::image_size`, is bounded and the least recently used
+ *   modules are evicted beyond that bound.
+ * * An optional on-disk tier in a directory which holds the output of
+ *   `Module::serialize` for every module compiled through this cache. On an
+ *   in-memory miss this tier is consulted via `Module::deserialize_file`
+ *   before falling back to compilation.
+ *
+ * Note that, like `Module::deserialize`, it is only safe to point the on-disk
+ * tier at a directory whose contents were written by a `ModuleCache`.
+ *
+ * A `ModuleCache` is safe to use concurrently from multiple threads. Lookups
+ * are serialized on an internal lock, but compilation happens outside of it,
+ * so concurrent misses for the same bytes may each compile the module.
+ *
+ * The `Engine` provided must outlive the cache.
+ */
+class ModuleCache {
+public:
+  /// Counters describing how effective a `ModuleCache` has been.
+  struct Stats {
+    /// Lookups satisfied by the in-memory tier.
+    uint64_t hits = 0;
+    /// Lookups satisfied by deserializing from the on-disk tier.
+    uint64_t disk_hits = 0;
+    /// Lookups which required compiling the module.
+    uint64_t misses = 0;
+    /// Modules evicted from the in-memory tier to stay within its bound.
+    uint64_t evictions = 0;
+    /// Number of modules currently held in memory.
+    size_t entries = 0;
+    /// Total `Module::image_size` of the modules currently held in memory.
+    size_t bytes = 0;
+  };
+
+private:
+  struct Entry {
+    std::string key;
+    Module module;
+    size_t size;
+  };
+
+  Engine *engine;
+  size_t max_bytes;
+  std::optional<std::string> dir;
+  std::string fingerprint;
+  // Set if the engine couldn't be fingerprinted, in which case every `get`
+  // fails with this message.
+  std::optional<std::string> fingerprint_error;
+
+  mutable std::mutex lock;
+  std::list<Entry> lru;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index;
+  Stats counters;
+
+  // The serialized form of an empty module embeds everything Wasmtime uses to
+  // check whether an artifact is compatible with an engine (version, target,
+  // and compilation settings), so its hash fingerprints the configuration.
+  // This compiles a module, so it only runs once per engine.
+  static Result<std::string> engine_fingerprint(Engine &engine) {
+    std::vector<uint8_t> empty = {0x00, 0x61, 0x73, 0x6d,
+                                  0x01, 0x00, 0x00, 0x00};
+    auto module = Module::compile(engine, empty);
+    if (!module) {
+      return module.err();
+    }
+    auto serialized = module.ok().serialize();
+    if (!serialized) {
+      return serialized.err();
+    }
+    auto bytes = serialized.ok();
+    detail::Sha256 hash;
+    hash.update(bytes.data(), bytes.size());
+    return detail::Sha256::hex(hash.finish());
+  }
+
+  // Returns a temporary file name next to `dst` which no other writer, in this
+  // or another process, will pick.
+  static std::string temp_path(const std::string &dst) {
+    static const uint64_t process_nonce =
+        (uint64_t(std::random_device()()) << 32) | std::random_device()();
+    static std::atomic<uint64_t> counter{0};
+    uint64_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    char buf[64];
+    snprintf(buf, sizeof(buf), ".%016llx-%llx-%llx.tmp",
+             static_cast<unsigned long long>(process_nonce),
+             static_cast<unsigned long long>(thread),
+             static_cast<unsigned long long>(
+                 counter.fetch_add(1, std::memory_order_relaxed)));
+    return dst + buf;
+  }
+
+  std::string key(Span<uint8_t> wasm) const {
+    detail::Sha256 hash;
+    hash.update(reinterpret_cast<const uint8_t *>(fingerprint.data()), // NOLINT
+                fingerprint.size());
+    hash.update(wasm.data(), wasm.size());
+    return detail::Sha256::hex(hash.finish());
+  }
+
+  std::string path(const std::string &key) const {
+    return *dir + "/" + key + ".cwasm";
+  }
+
+  // Must be called with `lock` held.
+  std::optional<Module> lookup(const std::string &key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+      return std::nullopt;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->module;
+  }
+
+  // Must be called with `lock` held.
+  void insert(const std::string &key, const Module &module) {
+    if (index.count(key) != 0) {
+      return;
+    }
+    size_t size = module.image_size();
+    lru.push_front(Entry{key, module, size});
+    index[key] = lru.begin();
+    counters.bytes += size;
+    while (counters.bytes > max_bytes && lru.size() > 1) {
+      auto &last = lru.back();
+      counters.bytes -= last.size;
+      index.erase(last.key);
+      lru.pop_back();
+      counters.evictions++;
+    }
+  }
+
+  void write(const std::string &key, const Module &module) const {
+    // Write to a temporary file first so a concurrent reader never observes a
+    // partially written artifact. Concurrent misses for the same key each get
+    // their own temporary file, and exclusive creation makes sure two writers
+    // never share one even if their names collided.
+    auto dst = path(key);
+    auto tmp = temp_path(dst);
+#ifdef _WIN32
+    int fd = ::_open(tmp.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+                     _S_IREAD | _S_IWRITE);
+    FILE *fh = fd < 0 ? nullptr : ::_fdopen(fd, "wb");
+#else
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    FILE *fh = fd < 0 ? nullptr : ::fdopen(fd, "wb");
+#endif
+    if (fh == nullptr) {
+      if (fd >= 0) {
+#ifdef _WIN32
+        ::_close(fd);
+#else
+        ::close(fd);
+#endif
+        std::remove(tmp.c_str());
+      }
+      return;
+    }
+    bool ok = static_cast<bool>(module.serialize_to(fh));
+    ok = ::fclose(fh) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), dst.c_str()) != 0) {
+      std::remove(tmp.c_str());
+    }
+  }
+
+public:
+  /**
+   * \brief Creates a new cache of modules compiled with `engine`.
+   *
+   * \param engine the engine used to compile and deserialize modules.
+   * \param max_bytes the bound on the total `Module::image_size` of modules
+   *        kept in memory. The most recently used module is always kept even
+   *        if it alone exceeds this bound.
+   * \param dir an optional existing directory to use as an on-disk tier.
+   */
+  ModuleCache(Engine &engine, size_t max_bytes,
+              std::optional<std::string> dir = std::nullopt)
+      : engine(&engine), max_bytes(max_bytes), dir(std::move(dir)) {
+    auto &cached = *engine.fingerprint;
+    std::call_once(cached.once, [&] {
+      auto result = engine_fingerprint(engine);
+      if (result) {
+        cached.digest = result.ok();
+      } else {
+        cached.error = result.err().message();
+      }
+    });
+    fingerprint = cached.digest;
+    fingerprint_error = cached.error;
+  }
+
+  ModuleCache(const ModuleCache &other) = delete;
+  ModuleCache(ModuleCache &&other) = delete;
+  ModuleCache &operator=(const ModuleCache &other) = delete;
+  ModuleCache &operator=(ModuleCache &&other) = delete;
+  ~ModuleCache() = default;
+
+  /**
+   * \brief Returns the module for `wasm`, compiling it if it's not cached.
+   *
+   * Returns an error if the module isn't cached and fails to compile, or if
+   * the engine's settings couldn't be fingerprinted when the cache was
+   * created.
+   */
+  Result<Module> get(Span<uint8_t> wasm) {
+    if (fingerprint_error) {
+      auto msg = "failed to fingerprint engine: " + *fingerprint_error;
+      return Error(wasmtime_error_new(msg.c_str()));
+    }
+    auto k = key(wasm);
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (auto module = lookup(k)) {
+        counters.hits++;
+        return *module;
+      }
+    }
+
+    if (dir) {
+      auto module = Module::deserialize_file(*engine, path(k));
+      if (module) {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.disk_hits++;
+        insert(k, module.ok());
+        return module;
+      }
+    }
+
+    auto module = Module::compile(*engine, wasm);
+    if (module && dir) {
+      write(k, module.ok());
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    counters.misses++;
+    if (module) {
+      insert(k, module.ok());
+    }
+    return module;
+  }
+
+  /// Returns a snapshot of this cache's counters.
+  Stats stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    Stats ret = counters;
+    ret.entries = lru.size();
+    return ret;
+  }
+
+  /// Drops all modules held in memory. The on-disk tier is left untouched.
+  void clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    lru.clear();
+    index.clear();
+    counters.bytes = 0;
+  }
+};
+
+/**
+ * \brief Builds a `Module` from a binary which arrives in chunks.
+ *
+ * Bytes are handed to `feed` as they are received, for example from the
+ * network. Each chunk is hashed with SHA-256 and checked against the framing
+ * of a WebAssembly binary (the header and the id and size of each section) as
+ * it arrives, so a truncated or non-WebAssembly upload is rejected as soon as
+ * possible and the binary's digest is ready the moment the last byte is in.
+ * Once all bytes are in, `finish` compiles the module.
+ *
+ * Wasmtime's C API only compiles complete binaries, so compilation itself
+ * starts when `finish` is called; the bytes are accumulated in one buffer,
+ * which can be sized up front with `reserve` when the length is known.
+ */
+class ModuleBuilder {
+  enum class State { Header, SectionId, SectionSize, Payload, Failed };
+
+  std::vector<uint8_t> bytes;
+  detail::Sha256 hash;
+  State state = State::Header;
+  std::string failure;
+  // Bytes of the current LEB128 section size read so far, and its value.
+  uint32_t leb_bytes = 0;
+  uint64_t leb_value = 0;
+  // Bytes left in the current section's payload.
+  uint64_t remaining = 0;
+
+  static constexpr std::array<uint8_t, 8> header = {0x00, 0x61, 0x73, 0x6d,
+                                                    0x01, 0x00, 0x00, 0x00};
+
+  Result<std::monostate> fail(std::string message) {
+    state = State::Failed;
+    failure = std::move(message);
+    return Error(wasmtime_error_new(failure.c_str()));
+  }
+
+  Result<std::monostate> parse(size_t start) {
+    for (size_t i = start; i < bytes.size();) {
+      uint8_t byte = bytes[i];
+      switch (state) {
+      case State::Header:
+        if (byte != header[i]) {
+          return fail("not a WebAssembly module: bad magic number or version");
+        }
+        if (++i == header.size()) {
+          state = State::SectionId;
+        }
+        break;
+      case State::SectionId:
+        i++;
+        state = State::SectionSize;
+        leb_bytes = 0;
+        leb_value = 0;
+        break;
+      case State::SectionSize:
+        leb_value |= uint64_t(byte & 0x7f) << (7 * leb_bytes);
+        i++;
+        if (++leb_bytes > 5 || leb_value > UINT32_MAX) {
+          return fail("malformed section size");
+        }
+        if ((byte & 0x80) == 0) {
+          remaining = leb_value;
+          state = remaining == 0 ? State::SectionId : State::Payload;
+        }
+        break;
+      case State::Payload: {
+        size_t n = size_t(std::min<uint64_t>(remaining, bytes.size() - i));
+        i += n;
+        remaining -= n;
+        if (remaining == 0) {
+          state = State::SectionId;
+        }
+        break;
+      }
+      case State::Failed:
+        return fail(failure);
+      }
+    }
+    return std::monostate();
+  }
+
+public:
+  /// Creates a builder with no bytes.
+  ModuleBuilder() = default;
+
+  /// Reserves space for a binary of `len` bytes.
+  void reserve(size_t len) { bytes.reserve(len); }
+
+  /**
+   * \brief Appends `chunk` to the binary.
+   *
+   * Returns an error if the bytes so far can't be the start of a
+   * WebAssembly module, after which the builder can't be used any more.
+   */
+  Result<std::monostate> feed(Span<const uint8_t> chunk) {
+    if (state == State::Failed) {
+      return fail(failure);
+    }
+    size_t start = bytes.size();
+    bytes.insert(bytes.end(), chunk.begin(), chunk.end());
+    hash.update(chunk.data(), chunk.size());
+    return parse(start);
+  }
+
+  /// Returns the number of bytes fed so far.
+  size_t size() const { return bytes.size(); }
+
+  /// Returns whether the bytes fed so far end at a section boundary, meaning
+  /// they could be a complete module.
+  bool complete() const { return state == State::SectionId; }
+
+  /// Returns the hexadecimal SHA-256 digest of the bytes fed so far.
+  std::string sha256() const {
+    detail::Sha256 copy = hash;
+    return detail::Sha256::hex(copy.finish());
+  }
+
+  /// Returns the bytes fed so far.
+  Span<uint8_t> data() { return bytes; }
+
+  /// \brief Validates the complete binary within the settings of `engine`.
+  Result<std::monostate> validate(Engine &engine) {
+    if (!complete()) {
+      return Error(wasmtime_error_new("WebAssembly module is incomplete"));
+    }
+    return Module::validate(engine, bytes);
+  }
+
+  /// \brief Compiles the complete binary within the settings of `engine`.
+  ///
+  /// Returns an error without compiling if the binary is truncated.
+  Result<Module> finish(Engine &engine) {
+    if (!complete()) {
+      return Error(wasmtime_error_new("WebAssembly module is incomplete"));
+    }
+    return Module::compile(engine, bytes);
+  }
+};
+
+/**
+ * \brief Configuration for an instance of WASI.
+ *
+ * This is inserted into a store with `Store::Context::set_wasi`.
+ */
+class WasiConfig {
+  friend class Store;
+
+  struct deleter {
+    void operator()(wasi_config_t *p) const { wasi_config_delete(p); }
+  };
+
+  std::unique_ptr<wasi_config_t, deleter> ptr;
+
+public:
+  /// Creates a new configuration object with default settings.
+  WasiConfig() : ptr(wasi_config_new()) {}
+
+  /// Configures the argv explicitly with the given string array.
+  void argv(const std::vector<std::string> &args) {
+    std::vector<const char *> ptrs;
+    ptrs.reserve(args.size());
+    for (const auto &arg : args) {
+      ptrs.push_back(arg.c_str());
+    }
+
+    wasi_config_set_argv(ptr.get(), (int)args.size(), ptrs.data());
+  }
+
+  /// Configures the argv for wasm to be inherited from this process itself.
+  void inherit_argv() { wasi_config_inherit_argv(ptr.get()); }
+
+  /// Configures the environment variables available to wasm, specified here as
   /// a list of pairs where the first element of the pair is the key and the
   /// second element is the value.
   void env(const std::vector<std::pair<std::string, std::string>> &env) {
@@ -1603,7 +2831,88 @@ public:
 };
 
 class Caller;
+class PreparedCall;
 template <typename Params, typename Results> class TypedFunc;
+template <typename T> class CallFuture;
+
+namespace detail {
+
+/// State this library keeps for a store, pointed to by the store's C API user
+/// data. Created lazily for a plain `Store`, the first time it's needed.
+struct StoreData {
+  /// Identifies the `T` of a `StoreDataBox<T>`, or null for a plain `Store`.
+  const void *tag = nullptr;
+  /// See `Store::Context::set_data`.
+  std::any untyped;
+  /// See `Store::resource_limiter`.
+  std::shared_ptr<ResourceLimiter> limiter;
+  /// Amounts `limiter` allowed this store which haven't been given back.
+  size_t memory_bytes = 0;
+  uint64_t table_elements = 0;
+
+  virtual ~StoreData() { release(); }
+
+  /// Gives everything charged to this store back to `limiter`.
+  void release() {
+    if (limiter && memory_bytes > 0) {
+      limiter->memory_released(memory_bytes);
+    }
+    if (limiter && table_elements > 0) {
+      limiter->table_released(table_elements);
+    }
+    memory_bytes = 0;
+    table_elements = 0;
+  }
+
+  static void finalizer(void *ptr) { delete static_cast<StoreData *>(ptr); }
+
+  /// Returns the limiter of the store `cx`, if it has one.
+  static ResourceLimiter *limiter_of(wasmtime_context_t *cx) {
+    auto *data = get(cx);
+    return data == nullptr ? nullptr : data->limiter.get();
+  }
+
+  /// Returns the state of the store `cx`, if it has any.
+  static StoreData *get(wasmtime_context_t *cx) {
+    return static_cast<StoreData *>(wasmtime_context_get_data(cx));
+  }
+
+  /// Returns the state of the store `cx`, creating it if the store doesn't
+  /// have any yet.
+  static StoreData &get_or_create(wasmtime_context_t *cx) {
+    auto *data = get(cx);
+    if (data == nullptr) {
+      data = new StoreData();
+      wasmtime_context_set_data(cx, data);
+    }
+    return *data;
+  }
+};
+
+/// `StoreData` followed by the user data of a `TypedStore<T>`.
+template <typename T> struct StoreDataBox : StoreData {
+  /// One distinct address per `T` which identifies boxes holding a `T`.
+  static constexpr char id = 0;
+
+  T value;
+
+  template <typename... Args>
+  explicit StoreDataBox(Args &&...args) : value(std::forward<Args>(args)...) {
+    tag = &id;
+  }
+
+  /// Returns the `T` of the store `cx`, or `nullptr` if it isn't a
+  /// `TypedStore<T>`.
+  static T *get(wasmtime_context_t *cx) {
+    auto *data = StoreData::get(cx);
+    if (data == nullptr || data->tag != &id) {
+      return nullptr;
+    }
+    return &static_cast<StoreDataBox *>(data)->value;
+  }
+};
+
+} // namespace detail
 
 /**
  * \brief Owner of all WebAssembly objects
@@ -1618,20 +2927,23 @@ template <typename Params, typename Results> class TypedFunc;
  * will be deallocated when the `Store` is deallocated.
  */
 class Store {
+  friend class GuestProfiler;
+
   struct deleter {
     void operator()(wasmtime_store_t *p) const { wasmtime_store_delete(p); }
   };
 
   std::unique_ptr<wasmtime_store_t, deleter> ptr;
 
-  static void finalizer(void *ptr) {
-    std::unique_ptr<std::any> _ptr(static_cast<std::any *>(ptr));
-  }
+protected:
+  /// Creates a new `Store` whose state, including its user data, is `data`.
+  Store(Engine &engine, detail::StoreData *data)
+      : ptr(wasmtime_store_new(engine.ptr.get(), data,
+                               detail::StoreData::finalizer)) {}
 
 public:
   /// Creates a new `Store` within the provided `Engine`.
-  explicit Store(Engine &engine)
-      : ptr(wasmtime_store_new(engine.ptr.get(), nullptr, finalizer)) {}
+  explicit Store(Engine &engine) : Store(engine, nullptr) {}
 
   /**
    * \brief An interior pointer into a `Store`.
@@ -1645,14 +2957,18 @@ public:
    * or a `Caller&`.
    */
   class Context {
+    friend class Store;
     friend class Global;
     friend class Table;
     friend class Memory;
     friend class Func;
     friend class Instance;
+    friend class InstancePre;
     friend class Linker;
     friend class ExternRef;
+    friend class MemoryView;
     friend class Val;
+    template <typename Params, typename Results> friend class TypedFunc;
     wasmtime_context_t *ptr;
 
     Context(wasmtime_context_t *ptr) : ptr(ptr) {}
@@ -1698,15 +3014,35 @@ public:
     }
 
     /// Set user specified data associated with this store.
+    ///
+    /// This is kept separately from the data of a `TypedStore`.
     void set_data(std::any data) const {
-      finalizer(static_cast<std::any *>(wasmtime_context_get_data(ptr)));
-      wasmtime_context_set_data(
-          ptr, std::make_unique<std::any>(std::move(data)).release());
+      detail::StoreData::get_or_create(ptr).untyped = std::move(data);
     }
 
     /// Get user specified data associated with this store.
     std::any &get_data() const {
-      return *static_cast<std::any *>(wasmtime_context_get_data(ptr));
+      return detail::StoreData::get_or_create(ptr).untyped;
+    }
+
+    /// \brief Get the user data of a `TypedStore<T>`.
+    ///
+    /// The check that this store was created as a `TypedStore<T>` with
+    /// exactly this `T` is a single pointer comparison. Aborts the process if
+    /// it wasn't; use `try_data` to handle that case instead.
+    template <typename T> T &data() const {
+      T *data = try_data<T>();
+      if (data == nullptr) {
+        fprintf(stderr, "store data is not of the requested type\n");
+        std::abort();
+      }
+      return *data;
+    }
+
+    /// Returns the user data of a `TypedStore<T>`, or `nullptr` if this store
+    /// wasn't created as a `TypedStore<T>`.
+    template <typename T> T *try_data() const {
+      return detail::StoreDataBox<T>::get(ptr);
     }
 
     /// Configures the WASI state used by this store.
@@ -1732,6 +3068,34 @@ public:
       wasmtime_context_set_epoch_deadline(ptr, ticks_beyond_current);
     }
 
+#ifdef WASMTIME_FEATURE_ASYNC
+    /// Configures asynchronous calls in this store to yield back to the poller
+    /// every `interval` units of fuel consumed.
+    ///
+    /// Requires `Config::consume_fuel` and `Config::async_support`.
+    Result<std::monostate> fuel_async_yield_interval(uint64_t interval) {
+      auto *error = wasmtime_context_fuel_async_yield_interval(ptr, interval);
+      if (error != nullptr) {
+        return Error(error);
+      }
+      return std::monostate();
+    }
+
+    /// Configures asynchronous calls in this store to yield back to the poller
+    /// when the epoch deadline is reached, after which the deadline is
+    /// extended by `delta` ticks.
+    ///
+    /// Requires `Config::epoch_interruption` and `Config::async_support`.
+    Result<std::monostate> epoch_deadline_async_yield_and_update(uint64_t delta) {
+      auto *error =
+          wasmtime_context_epoch_deadline_async_yield_and_update(ptr, delta);
+      if (error != nullptr) {
+        return Error(error);
+      }
+      return std::monostate();
+    }
+#endif // WASMTIME_FEATURE_ASYNC
+
     /// Returns the raw context pointer for the C API.
     wasmtime_context_t *raw_context() { return ptr; }
   };
@@ -1772,84 +3136,483 @@ public:
                            tables, memories);
   }
 
+  /// \brief Configures `limiter` to be consulted before memories and tables
+  /// of this store are created or grown through this library.
+  ///
+  /// See `ResourceLimiter` for which growth is seen by the limiter. Anything
+  /// allowed by a previous limiter is given back to it first. The same
+  /// limiter can be shared by any number of stores.
+  void resource_limiter(std::shared_ptr<ResourceLimiter> limiter) {
+    auto *cx = wasmtime_store_context(ptr.get());
+    detail::StoreData *data = &detail::StoreData::get_or_create(cx);
+    data->release();
+    data->limiter = std::move(limiter);
+  }
+
+  /// \brief The action to take once a store's epoch deadline is reached, as
+  /// decided by an `epoch_deadline_callback`.
+  class EpochDeadline {
+    friend class Store;
+    wasmtime_update_deadline_kind_t kind;
+    uint64_t delta;
+
+    EpochDeadline(wasmtime_update_deadline_kind_t kind, uint64_t delta)
+        : kind(kind), delta(delta) {}
+
+  public:
+    /// Keeps running, with a new deadline `delta` ticks beyond the current
+    /// epoch.
+    static EpochDeadline continue_for(uint64_t delta) {
+      return EpochDeadline(WASMTIME_UPDATE_DEADLINE_CONTINUE, delta);
+    }
+
+    /// Yields back to the poller of an asynchronous call and then keeps
+    /// running with a new deadline `delta` ticks beyond the current epoch.
+    ///
+    /// Only valid for stores with `Config::async_support` enabled.
+    static EpochDeadline yield_for(uint64_t delta) {
+      return EpochDeadline(WASMTIME_UPDATE_DEADLINE_YIELD, delta);
+    }
+  };
+
+private:
+  template <typename F>
+  static wasmtime_error_t *
+  raw_epoch_deadline_callback(wasmtime_context_t *cx, void *env,
+                              uint64_t *delta,
+                              wasmtime_update_deadline_kind_t *kind) {
+    Result<EpochDeadline> result = (*static_cast<F *>(env))(Context(cx));
+    if (!result) {
+      return result.err().ptr.release();
+    }
+    *delta = result.ok().delta;
+    *kind = result.ok().kind;
+    return nullptr;
+  }
+
+  template <typename F> static void raw_epoch_deadline_finalize(void *env) {
+    std::unique_ptr<F> ptr(static_cast<F *>(env));
+  }
+
+public:
+  /// \brief Configures a callback invoked whenever this store's epoch
+  /// deadline is reached, replacing the default behavior of trapping.
+  ///
+  /// The callable `f` is invoked as `f(Store::Context)` and returns a
+  /// `Result<Store::EpochDeadline>`: either how to continue, or an error with
+  /// which the running WebAssembly traps. This allows well-behaved
+  /// long-running guests to be given more time without recreating the store.
+  ///
+  /// Requires `Config::epoch_interruption`.
+  template <typename F,
+            std::enable_if_t<std::is_invocable_r_v<Result<EpochDeadline>, F,
+                                                   Context>,
+                             bool> = true>
+  void epoch_deadline_callback(F f) {
+    wasmtime_store_epoch_deadline_callback(
+        ptr.get(), raw_epoch_deadline_callback<F>, new F(std::move(f)),
+        raw_epoch_deadline_finalize<F>);
+  }
+
   /// Explicit function to acquire a `Context` from this store.
   Context context() { return this; }
 };
 
+#ifdef WASMTIME_FEATURE_PROFILING
 /**
- * \brief Representation of a WebAssembly `externref` value.
+ * \brief A sampling profiler of WebAssembly code running in a `Store`.
  *
- * This class represents an value that cannot be forged by WebAssembly itself.
- * All `ExternRef` values are guaranteed to be created by the host and its
- * embedding. It's suitable to place private data structures in here which
- * WebAssembly will not have access to, only other host functions will have
- * access to them.
+ * Samples of the guest call stack are taken by calling `sample`, typically
+ * from an epoch deadline callback installed with `attach`, and `finish`
+ * produces a profile in the JSON format understood by the [Firefox
+ * Profiler](https://profiler.firefox.com/). No external tooling or special
+ * build is needed, so a profiler can be attached to a sampled fraction of
+ * requests in production.
  *
- * Note that `ExternRef` values are rooted within a `Store` and must be manually
- * unrooted via the `unroot` function. If this is not used then values will
- * never be candidates for garbage collection.
+ * Only functions of the modules given to the constructor are symbolized.
+ *
+ * For more information be sure to consult the [rust
+ * documentation](https://docs.wasmtime.dev/api/wasmtime/struct.GuestProfiler.html).
  */
-class ExternRef {
-  friend class Val;
-
-  wasmtime_externref_t val;
+class GuestProfiler {
+  struct deleter {
+    void operator()(wasmtime_guestprofiler_t *p) const {
+      wasmtime_guestprofiler_delete(p);
+    }
+  };
 
-  static void finalizer(void *ptr) {
-    std::unique_ptr<std::any> _ptr(static_cast<std::any *>(ptr));
-  }
+  std::unique_ptr<wasmtime_guestprofiler_t, deleter> ptr;
+  std::chrono::steady_clock::time_point last_sample;
 
 public:
-  /// Creates a new `ExternRef` directly from its C-API representation.
-  explicit ExternRef(wasmtime_externref_t val) : val(val) {}
-
-  /// Creates a new `externref` value from the provided argument.
-  ///
-  /// Note that `val` should be safe to send across threads and should own any
-  /// memory that it points to. Also note that `ExternRef` is similar to a
-  /// `std::shared_ptr` in that there can be many references to the same value.
-  template <typename T> explicit ExternRef(Store::Context cx, T val) {
-    void *ptr = std::make_unique<std::any>(std::move(val)).release();
-    bool ok = wasmtime_externref_new(cx.ptr, ptr, finalizer, &this->val);
-    if (!ok)  {
-      fprintf(stderr, "failed to allocate a new externref");
-      abort();
+  /// \brief Creates a profiler named `name` which expects to be sampled every
+  /// `interval`, symbolizing the `modules` given with their names.
+  GuestProfiler(std::string_view name, std::chrono::nanoseconds interval,
+                const std::vector<std::pair<std::string, Module>> &modules)
+      : last_sample(std::chrono::steady_clock::now()) {
+    std::vector<wasm_name_t> names(modules.size());
+    std::vector<wasmtime_guestprofiler_modules_t> raw(modules.size());
+    for (size_t i = 0; i < modules.size(); i++) {
+      names[i].size = modules[i].first.size();
+      names[i].data = const_cast<char *>(modules[i].first.data());
+      raw[i].name = &names[i];
+      raw[i].mod = modules[i].second.ptr.get();
     }
+    wasm_name_t raw_name;
+    raw_name.size = name.size();
+    raw_name.data = const_cast<char *>(name.data());
+    ptr.reset(wasmtime_guestprofiler_new(&raw_name, interval.count(),
+                                         raw.data(), raw.size()));
   }
 
-  /// Creates a new `ExternRef` which is separately rooted from this one.
-  ExternRef clone(Store::Context cx) {
-    wasmtime_externref_t other;
-    wasmtime_externref_clone(cx.ptr, &val, &other);
-    return ExternRef(other);
-  }
-
-  /// Returns the underlying host data associated with this `ExternRef`.
-  std::any &data(Store::Context cx) {
-    return *static_cast<std::any *>(wasmtime_externref_data(cx.ptr, &val));
+  /// \brief Records a sample of the WebAssembly stack currently executing in
+  /// `store`, attributing `delta` of CPU time to it.
+  void sample(const Store &store, std::chrono::nanoseconds delta) {
+    wasmtime_guestprofiler_sample(ptr.get(), store.ptr.get(), delta.count());
   }
 
-  /// Unroots this value from the context provided, enabling a future GC to
-  /// collect the internal object if there are no more references.
-  void unroot(Store::Context cx) {
-    wasmtime_externref_unroot(cx.ptr, &val);
+  /// \brief Records a sample as in `sample`, attributing the time elapsed
+  /// since the previous sample (or the creation of this profiler).
+  void sample(const Store &store) {
+    auto now = std::chrono::steady_clock::now();
+    sample(store, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      now - last_sample));
+    last_sample = now;
   }
 
-  /// Returns the raw underlying C API value.
+  /// \brief Installs an epoch deadline callback on `store` which takes a
+  /// sample and then continues for another `ticks` epoch ticks.
   ///
-  /// This class still retains ownership of the pointer.
-  const wasmtime_externref_t *raw() const { return &val; }
+  /// This replaces any previous `Store::epoch_deadline_callback`, and the
+  /// profiler must outlive all execution in `store` until `finish` is called
+  /// and the callback is replaced. The store's engine must have
+  /// `Config::epoch_interruption` enabled and something must be calling
+  /// `Engine::increment_epoch` periodically.
+  void attach(Store &store, uint64_t ticks = 1) {
+    Store *s = &store;
+    store.epoch_deadline_callback(
+        [this, s, ticks](Store::Context) -> Result<Store::EpochDeadline> {
+          sample(*s);
+          return Store::EpochDeadline::continue_for(ticks);
+        });
+    store.context().set_epoch_deadline(ticks);
+  }
+
+  /// \brief Finishes profiling, returning the profile as Firefox Profiler
+  /// JSON.
+  ///
+  /// This consumes the profiler, after which it must not be used.
+  Result<ByteVec> finish() {
+    wasm_byte_vec_t out;
+    auto *error = wasmtime_guestprofiler_finish(ptr.release(), &out);
+    if (error != nullptr) {
+      return Error(error);
+    }
+    return ByteVec(out);
+  }
+};
+#endif // WASMTIME_FEATURE_PROFILING
+
+/**
+ * \brief A `Store` with user data of a statically known type `T`.
+ *
+ * The `T` is allocated once, when the store is created, and destroyed along
+ * with the store. Unlike `Store::Context::get_data` there's no `std::any` in
+ * between, so host functions can reach their state through
+ * `caller.context().data<T>()` with a single pointer dereference.
+ *
+ * A `TypedStore<T>` can be used anywhere a `Store` is expected, and
+ * `Store::Context::data<T>` checks that the store really holds a `T`. The
+ * untyped `set_data` and `get_data` keep working alongside it.
+ *
+ * The `T` lives in the same allocation as the rest of the store's state
+ * rather than inline in the `TypedStore`, since a store can be moved while
+ * wasmtime keeps pointing at its data.
+ */
+template <typename T> class TypedStore : public Store {
+public:
+  /// Creates a new store within `engine` whose data is constructed from
+  /// `args`.
+  template <typename... Args>
+  explicit TypedStore(Engine &engine, Args &&...args)
+      : Store(engine, new detail::StoreDataBox<T>(std::forward<Args>(args)...)) {
+  }
+
+  /// Returns this store's data.
+  T &data() { return context().data<T>(); }
+  /// Returns this store's data.
+  const T &data() const {
+    return const_cast<TypedStore *>(this)->context().data<T>();
+  }
+};
+
+namespace detail {
+
+/// Common header at the start of the host data of every `externref` created
+/// by `ExternRef` or `TypedExternRef`, recording which of them created it.
+///
+/// The pointer handed to wasmtime is always the address of this header, so
+/// the tag can be checked before the data is interpreted as a specific type.
+struct ExternRefHeader {
+  const void *tag;
+};
+
+/// Host data of a `TypedExternRef<T>`, or of an `ExternRef` with
+/// `T = std::any`.
+template <typename T> struct ExternRefBox : ExternRefHeader {
+  /// One distinct address per `T` which identifies boxes holding a `T`.
+  static constexpr char id = 0;
+
+  T value;
+
+  template <typename... Args>
+  explicit ExternRefBox(Args &&...args)
+      : ExternRefHeader{&id}, value(std::forward<Args>(args)...) {}
+
+  static void finalizer(void *ptr) {
+    delete static_cast<ExternRefBox *>(static_cast<ExternRefHeader *>(ptr));
+  }
+
+  /// Allocates a new `externref` holding a `T` built from `args`, aborting
+  /// the process on failure like `ExternRef` does.
+  template <typename... Args>
+  static wasmtime_externref_t make(wasmtime_context_t *cx, Args &&...args) {
+    auto box = std::make_unique<ExternRefBox>(std::forward<Args>(args)...);
+    wasmtime_externref_t ret;
+    ExternRefHeader *header = box.get();
+    if (!wasmtime_externref_new(cx, header, finalizer, &ret)) {
+      fprintf(stderr, "failed to allocate a new externref\n");
+      abort();
+    }
+    box.release();
+    return ret;
+  }
+
+  /// Returns the `T` behind `ref`, or `nullptr` if `ref` doesn't hold one.
+  static T *get(wasmtime_context_t *cx, const wasmtime_externref_t *ref) {
+    auto *header =
+        static_cast<ExternRefHeader *>(wasmtime_externref_data(cx, ref));
+    if (header == nullptr || header->tag != &id) {
+      return nullptr;
+    }
+    return &static_cast<ExternRefBox *>(header)->value;
+  }
+};
+
+} // namespace detail
+
+/**
+ * \brief Representation of a WebAssembly `externref` value.
+ *
+ * This class represents an value that cannot be forged by WebAssembly itself.
+ * All `ExternRef` values are guaranteed to be created by the host and its
+ * embedding. It's suitable to place private data structures in here which
+ * WebAssembly will not have access to, only other host functions will have
+ * access to them.
+ *
+ * Note that `ExternRef` values are rooted within a `Store` and must be manually
+ * unrooted via the `unroot` function. If this is not used then values will
+ * never be candidates for garbage collection.
+ */
+class ExternRef {
+  friend class Val;
+
+  wasmtime_externref_t val;
+
+  using Box = detail::ExternRefBox<std::any>;
+
+public:
+  /// Creates a new `ExternRef` directly from its C-API representation.
+  explicit ExternRef(wasmtime_externref_t val) : val(val) {}
+
+  /// Creates a new `externref` value from the provided argument.
+  ///
+  /// Note that `val` should be safe to send across threads and should own any
+  /// memory that it points to. Also note that `ExternRef` is similar to a
+  /// `std::shared_ptr` in that there can be many references to the same value.
+  template <typename T>
+  explicit ExternRef(Store::Context cx, T val)
+      : val(Box::make(cx.ptr, std::in_place_type<T>, std::move(val))) {}
+
+  /// Creates a new `ExternRef` which is separately rooted from this one.
+  ExternRef clone(Store::Context cx) {
+    wasmtime_externref_t other;
+    wasmtime_externref_clone(cx.ptr, &val, &other);
+    return ExternRef(other);
+  }
+
+  /// Returns the underlying host data associated with this `ExternRef`.
+  ///
+  /// Returns `nullptr` if this value wasn't created by an `ExternRef`, for
+  /// example if it came from a `TypedExternRef`.
+  std::any *data(Store::Context cx) { return Box::get(cx.ptr, &val); }
+
+  /// Unroots this value from the context provided, enabling a future GC to
+  /// collect the internal object if there are no more references.
+  void unroot(Store::Context cx) {
+    wasmtime_externref_unroot(cx.ptr, &val);
+  }
+
+  /// Returns the raw underlying C API value.
+  ///
+  /// This class still retains ownership of the pointer.
+  const wasmtime_externref_t *raw() const { return &val; }
+};
+
+/**
+ * \brief Typed representation of a WebAssembly `externref` value.
+ *
+ * This is an alternative to `ExternRef` for hosts that know statically what
+ * kind of object lives behind an `externref`. The `T` is stored inline in the
+ * host data owned by the store, so creating a value costs a single allocation
+ * and accessing it is a tag comparison and pointer load instead of a
+ * `std::any_cast`.
+ *
+ * The host data starts with a tag which records the `T` it was created with,
+ * and `get` checks it. That means a guest can't pass a reference of another
+ * type, an untyped `ExternRef`, or a `TypedExternRef<U>` from another import
+ * back into a host function and have it read as a `T`. Like `ExternRef`,
+ * values are rooted within a `Store` and must be unrooted, either manually
+ * via `unroot` or in bulk with a `RootScope`.
+ */
+template <typename T> class TypedExternRef {
+  wasmtime_externref_t val;
+
+  using Box = detail::ExternRefBox<T>;
+
+public:
+  /// Creates a new `TypedExternRef` directly from its C-API representation.
+  ///
+  /// Values which weren't created by a `TypedExternRef<T>` are detected by
+  /// `get` and `is`.
+  explicit TypedExternRef(wasmtime_externref_t val) : val(val) {}
+
+  /// Views an untyped `ExternRef`, sharing its root.
+  explicit TypedExternRef(const ExternRef &ref) : val(*ref.raw()) {}
+
+  /// Creates a new `externref` value holding `value`.
+  ///
+  /// The object is destroyed once wasmtime garbage collects the reference.
+  TypedExternRef(Store::Context cx, T value)
+      : val(Box::make(cx.raw_context(), std::move(value))) {}
+
+  /// Creates a new `externref` value holding a `T` constructed from `args`.
+  template <typename... Args>
+  static TypedExternRef make(Store::Context cx, Args &&...args) {
+    return TypedExternRef(
+        Box::make(cx.raw_context(), std::forward<Args>(args)...));
+  }
+
+  /// Creates a new `TypedExternRef` which is separately rooted from this one.
+  TypedExternRef clone(Store::Context cx) const {
+    wasmtime_externref_t other;
+    wasmtime_externref_clone(cx.raw_context(), &val, &other);
+    return TypedExternRef(other);
+  }
+
+  /// Returns the host object associated with this reference, or `nullptr`
+  /// if this reference wasn't created by a `TypedExternRef<T>`.
+  T *get(Store::Context cx) const { return Box::get(cx.raw_context(), &val); }
+
+  /// Returns whether this reference was created by a `TypedExternRef<T>`.
+  bool is(Store::Context cx) const { return get(cx) != nullptr; }
+
+  /// Unroots this value from the context provided, enabling a future GC to
+  /// collect the internal object if there are no more references.
+  void unroot(Store::Context cx) {
+    wasmtime_externref_unroot(cx.raw_context(), &val);
+  }
+
+  /// Returns an untyped `ExternRef` sharing this value's root, for use with
+  /// `Val` and other untyped APIs.
+  ExternRef untyped() const { return ExternRef(val); }
+
+  /// Returns the raw underlying C API value.
+  ///
+  /// This class still retains ownership of the pointer.
+  const wasmtime_externref_t *raw() const { return &val; }
+};
+
+/**
+ * \brief RAII helper which unroots a group of `externref` values at once.
+ *
+ * Every reference created through, or handed to, a `RootScope` is recorded and
+ * unrooted when the scope is destroyed or `clear` is called. This replaces a
+ * per-value `unroot` call sprinkled through host code when many short-lived
+ * references are passed into wasm for the duration of a single request.
+ *
+ * References tracked by a scope must not be used after the scope ends; use
+ * `clone` on a value which needs to outlive it.
+ */
+class RootScope {
+  Store::Context cx;
+  std::vector<wasmtime_externref_t> roots;
+
+public:
+  /// Creates a new empty scope tracking roots within `cx`.
+  explicit RootScope(Store::Context cx) : cx(cx) {}
+  RootScope(const RootScope &) = delete;
+  RootScope &operator=(const RootScope &) = delete;
+  ~RootScope() { clear(); }
+
+  /// Reserves space for `n` roots, avoiding reallocation while a batch of
+  /// references is created.
+  void reserve(size_t n) { roots.reserve(n); }
+
+  /// Returns the number of roots currently tracked.
+  size_t size() const { return roots.size(); }
+
+  /// Creates a `TypedExternRef<T>` owned by this scope.
+  template <typename T, typename... Args>
+  TypedExternRef<T> make(Args &&...args) {
+    auto ref = TypedExternRef<T>::make(cx, std::forward<Args>(args)...);
+    roots.push_back(*ref.raw());
+    return ref;
+  }
+
+  /// Creates an untyped `ExternRef` owned by this scope.
+  template <typename T> ExternRef externref(T val) {
+    ExternRef ref(cx, std::move(val));
+    roots.push_back(*ref.raw());
+    return ref;
+  }
+
+  /// Hands ownership of the root of `ref` to this scope.
+  void adopt(const ExternRef &ref) { roots.push_back(*ref.raw()); }
+
+  /// Hands ownership of the root of `ref` to this scope.
+  template <typename T> void adopt(const TypedExternRef<T> &ref) {
+    roots.push_back(*ref.raw());
+  }
+
+  /// Unroots every value tracked so far, leaving the scope empty.
+  ///
+  /// The C API has no batch unroot, so this still makes one
+  /// `wasmtime_externref_unroot` call per tracked value.
+  void clear() {
+    for (auto &root : roots) {
+      wasmtime_externref_unroot(cx.raw_context(), &root);
+    }
+    roots.clear();
+  }
 };
 
 class Func;
 class Global;
 class Instance;
 class Memory;
+class SharedMemory;
 class Table;
 
 /// \typedef Extern
 /// \brief Representation of an external WebAssembly item
 typedef std::variant<Func, Global, Memory, Table> Extern;
 
+/// \typedef ExportItem
+/// \brief Any item an `Instance` can export: an `Extern`, or a
+/// `SharedMemory`, which isn't owned by a store and so isn't an `Extern`.
+typedef std::variant<Func, Global, Memory, Table, SharedMemory> ExportItem;
+
 /// \brief Container for the `v128` WebAssembly type.
 struct V128 {
   /// \brief The little-endian bytes of the `v128` value.
@@ -1878,16 +3641,21 @@ class Val {
   friend class Global;
   friend class Table;
   friend class Func;
+  friend class PreparedCall;
 
   wasmtime_val_t val;
 
+  Val(wasmtime_val_t val) : val(val) {}
+
+public:
+  /// Creates a new `i32` WebAssembly value of 0.
+  ///
+  /// This is primarily useful as placeholder storage for the results of
+  /// `Func::call`, which will overwrite it.
   Val() : val{} {
     val.kind = WASMTIME_I32;
     val.of.i32 = 0;
   }
-  Val(wasmtime_val_t val) : val(val) {}
-
-public:
   /// Creates a new `i32` WebAssembly value.
   Val(int32_t i32) : val{} {
     val.kind = WASMTIME_I32;
@@ -1929,6 +3697,10 @@ public:
   /// Creates a new `externref` WebAssembly value which is not `ref.null
   /// extern`.
   Val(ExternRef ptr);
+  /// Creates a new `externref` WebAssembly value from a typed reference,
+  /// sharing its root.
+  template <typename T>
+  Val(const TypedExternRef<T> &ptr) : Val(std::optional(ptr.untyped())) {}
 
   /// Returns the kind of value that this value has.
   ValKind kind() const {
@@ -2035,6 +3807,7 @@ public:
  */
 class Caller {
   friend class Func;
+  friend class Linker;
   friend class Store;
   wasmtime_caller_t *ptr;
   Caller(wasmtime_caller_t *ptr) : ptr(ptr) {}
@@ -2109,6 +3882,39 @@ template <> struct WasmType<std::optional<ExternRef>> {
   }
 };
 
+/// Type information for `externref`, represented on the host as an optional
+/// `TypedExternRef<T>`.
+///
+/// An `externref` which doesn't hold a `T` created by `TypedExternRef<T>` is
+/// loaded as `std::nullopt`, so host functions never see a value of the wrong
+/// type.
+template <typename T> struct WasmType<std::optional<TypedExternRef<T>>> {
+  static const bool valid = true;
+  static const ValKind kind = ValKind::ExternRef;
+  static void store(Store::Context cx, wasmtime_val_raw_t *p,
+                    const std::optional<TypedExternRef<T>> &ref) {
+    if (ref) {
+      p->externref = wasmtime_externref_to_raw(cx.raw_context(), ref->raw());
+    } else {
+      p->externref = 0;
+    }
+  }
+  static std::optional<TypedExternRef<T>> load(Store::Context cx,
+                                               wasmtime_val_raw_t *p) {
+    if (p->externref == 0) {
+      return std::nullopt;
+    }
+    wasmtime_externref_t val;
+    wasmtime_externref_from_raw(cx.raw_context(), p->externref, &val);
+    TypedExternRef<T> ref(val);
+    if (!ref.is(cx)) {
+      ref.unroot(cx);
+      return std::nullopt;
+    }
+    return ref;
+  }
+};
+
 /// Type information for the `V128` host value used as a wasm value.
 template <> struct WasmType<V128> {
   static const bool valid = true;
@@ -2119,6 +3925,12 @@ template <> struct WasmType<V128> {
   static V128 load(Store::Context cx, wasmtime_val_raw_t *p) { return p->v128; }
 };
 
+/// Whether the native type `T` can be moved in and out of WebAssembly without
+/// a `Store::Context`, which is the case for everything but reference types.
+template <typename T>
+inline constexpr bool wasm_type_plain =
+    std::is_arithmetic_v<T> || std::is_same_v<T, V128>;
+
 /// A "trait" for a list of types and operations on them, used for `Func::wrap`
 /// and `TypedFunc::call`
 ///
@@ -2126,6 +3938,7 @@ template <> struct WasmType<V128> {
 template <typename T> struct WasmTypeList {
   static const bool valid = WasmType<T>::valid;
   static const size_t size = 1;
+  static constexpr bool plain = wasm_type_plain<T>;
   static bool matches(ValType::ListRef types) {
     return WasmTypeList<std::tuple<T>>::matches(types);
   }
@@ -2143,10 +3956,12 @@ template <typename T> struct WasmTypeList {
 template <> struct WasmTypeList<std::monostate> {
   static const bool valid = true;
   static const size_t size = 0;
+  static constexpr bool plain = true;
   static bool matches(ValType::ListRef types) { return types.size() == 0; }
-  static void store(Store::Context cx, wasmtime_val_raw_t *storage,
-                    const std::monostate &t) {}
-  static std::monostate load(Store::Context cx, wasmtime_val_raw_t *storage) {
+  static void store(Store::Context /*cx*/, wasmtime_val_raw_t * /*storage*/,
+                    const std::monostate & /*t*/) {}
+  static std::monostate load(Store::Context /*cx*/,
+                             wasmtime_val_raw_t * /*storage*/) {
     return std::monostate();
   }
   static std::vector<ValType> types() { return {}; }
@@ -2156,6 +3971,7 @@ template <> struct WasmTypeList<std::monostate> {
 template <typename... T> struct WasmTypeList<std::tuple<T...>> {
   static const bool valid = (WasmType<T>::valid && ...);
   static const size_t size = sizeof...(T);
+  static constexpr bool plain = (wasm_type_plain<T> && ...);
   static bool matches(ValType::ListRef types) {
     if (types.size() != size) {
       return false;
@@ -2184,6 +4000,7 @@ template <typename... T> struct WasmTypeList<std::tuple<T...>> {
 /// The base case here is a bare return value like `int32_t`.
 template <typename R> struct WasmHostRet {
   using Results = WasmTypeList<R>;
+  static constexpr bool infallible = true;
 
   template <typename F, typename... A>
   static std::optional<Trap> invoke(F f, Caller cx, wasmtime_val_raw_t *raw,
@@ -2197,6 +4014,7 @@ template <typename R> struct WasmHostRet {
 /// Host functions can return nothing
 template <> struct WasmHostRet<void> {
   using Results = WasmTypeList<std::tuple<>>;
+  static constexpr bool infallible = true;
 
   template <typename F, typename... A>
   static std::optional<Trap> invoke(F f, Caller cx, wasmtime_val_raw_t *raw,
@@ -2214,6 +4032,7 @@ template <> struct WasmHostRet<std::monostate> : public WasmHostRet<void> {};
 /// a trap.
 template <typename R> struct WasmHostRet<Result<R, Trap>> {
   using Results = WasmTypeList<R>;
+  static constexpr bool infallible = false;
 
   template <typename F, typename... A>
   static std::optional<Trap> invoke(F f, Caller cx, wasmtime_val_raw_t *raw,
@@ -2234,6 +4053,18 @@ template <typename F, typename = void> struct WasmHostFunc;
 template <typename R, typename... A> struct WasmHostFunc<R (*)(A...)> {
   using Params = WasmTypeList<std::tuple<A...>>;
   using Results = typename WasmHostRet<R>::Results;
+  /// The return type of the host function.
+  using Return = R;
+  /// The WebAssembly parameters of the host function, excluding any `Caller`.
+  using Args = std::tuple<A...>;
+  /// Whether the host function takes a `Caller` as its first parameter.
+  static constexpr bool takes_caller = false;
+  /// Whether the host function can never raise a trap.
+  static constexpr bool infallible = WasmHostRet<R>::infallible;
+  /// Whether moving the parameters and results in and out of WebAssembly
+  /// needs a `Store::Context`, which only reference types do.
+  static constexpr bool needs_context =
+      !(wasm_type_plain<A> && ...) || !WasmHostRet<R>::Results::plain;
 
   template <typename F>
   static std::optional<Trap> invoke(F &f, Caller cx, wasmtime_val_raw_t *raw) {
@@ -2249,6 +4080,8 @@ template <typename R, typename... A> struct WasmHostFunc<R (*)(A...)> {
 /// Function type information, but with a `Caller` first parameter
 template <typename R, typename... A>
 struct WasmHostFunc<R (*)(Caller, A...)> : public WasmHostFunc<R (*)(A...)> {
+  static constexpr bool takes_caller = true;
+
   // Override `invoke` here to pass the `cx` as the first parameter
   template <typename F>
   static std::optional<Trap> invoke(F &f, Caller cx, wasmtime_val_raw_t *raw) {
@@ -2287,6 +4120,78 @@ template <typename T>
 struct WasmHostFunc<T, std::void_t<decltype(&T::operator())>>
     : public WasmHostFunc<decltype(&T::operator())> {};
 
+/// Whether calling a `F` never modifies it: `F` is a function pointer or has
+/// exactly one `const` call operator.
+template <typename F, typename = void>
+struct HostCallIsConst : std::is_pointer<F> {};
+
+template <typename M> struct HostMethodIsConst : std::false_type {};
+template <typename R, typename C, typename... A>
+struct HostMethodIsConst<R (C::*)(A...) const> : std::true_type {};
+template <typename R, typename C, typename... A>
+struct HostMethodIsConst<R (C::*)(A...) const noexcept> : std::true_type {};
+
+template <typename F>
+struct HostCallIsConst<F, std::void_t<decltype(&F::operator())>>
+    : HostMethodIsConst<decltype(&F::operator())> {};
+
+/// How a host callable `F` is stored in the `void *` environment given to the
+/// C API.
+///
+/// Callables which are trivially copyable, no bigger than a pointer, and
+/// unchanged by being called (captureless lambdas, function pointers, lambdas
+/// capturing a single pointer or reference) are stored in the environment
+/// pointer itself, with no allocation or finalizer. Anything else is
+/// allocated on the heap and deleted by the finalizer.
+template <typename F> class HostEnv {
+public:
+  static constexpr bool is_inline = std::is_trivially_copyable_v<F> &&
+                                    sizeof(F) <= sizeof(void *) &&
+                                    HostCallIsConst<F>::value;
+
+private:
+  alignas(F) unsigned char storage[is_inline ? sizeof(F) : 1];
+  F *ptr;
+
+  static void finalize(void *env) {
+    std::unique_ptr<F> ptr(static_cast<F *>(env));
+  }
+
+public:
+  /// Recovers the callable from an environment created by `make`.
+  explicit HostEnv(void *env) {
+    if constexpr (is_inline) {
+      if constexpr (!std::is_empty_v<F>) {
+        memcpy(storage, &env, sizeof(F));
+      }
+      ptr = std::launder(reinterpret_cast<F *>(storage)); // NOLINT
+    } else {
+      ptr = static_cast<F *>(env);
+    }
+  }
+
+  /// Returns the callable.
+  F &get() { return *ptr; }
+
+  /// Creates the environment to hand to the C API for `f`.
+  template <typename G> static void *make(G &&f) {
+    if constexpr (is_inline) {
+      void *env = nullptr;
+      if constexpr (!std::is_empty_v<F>) {
+        const F &copy = f;
+        memcpy(&env, &copy, sizeof(F));
+      }
+      return env;
+    } else {
+      return new F(std::forward<G>(f));
+    }
+  }
+
+  /// The finalizer to hand to the C API along with `make`'s environment.
+  static constexpr void (*finalizer)(void *) =
+      is_inline ? nullptr : &HostEnv::finalize;
+};
+
 } // namespace detail
 
 using namespace detail;
@@ -2316,7 +4221,8 @@ class Func {
                                    wasmtime_val_t *results, size_t nresults) {
     static_assert(alignof(Val) == alignof(wasmtime_val_t));
     static_assert(sizeof(Val) == sizeof(wasmtime_val_t));
-    F *func = reinterpret_cast<F *>(env);                          // NOLINT
+    detail::HostEnv<F> env_storage(env);
+    F *func = &env_storage.get();
     Span<const Val> args_span(reinterpret_cast<const Val *>(args), // NOLINT
                               nargs);
     Span<Val> results_span(reinterpret_cast<Val *>(results), // NOLINT
@@ -2336,7 +4242,8 @@ class Func {
                          size_t nargs_and_results) {
     using HostFunc = WasmHostFunc<F>;
     Caller cx(caller);
-    F *func = reinterpret_cast<F *>(env); // NOLINT
+    detail::HostEnv<F> env_storage(env);
+    F *func = &env_storage.get();
     auto trap = HostFunc::invoke(*func, cx, args_and_results);
     if (trap) {
       return trap->ptr.release();
@@ -2344,6 +4251,45 @@ class Func {
     return nullptr;
   }
 
+  template <typename F, size_t... I>
+  static void invoke_noexcept(F &f, wasmtime_caller_t *caller,
+                              Store::Context cx, wasmtime_val_raw_t *raw,
+                              std::index_sequence<I...>) {
+    using HostFunc = WasmHostFunc<F>;
+    using Args = typename HostFunc::Args;
+    using R = typename HostFunc::Return;
+    auto call = [&]() -> R {
+      if constexpr (HostFunc::takes_caller) {
+        return f(Caller(caller),
+                 WasmType<std::tuple_element_t<I, Args>>::load(cx, &raw[I])...);
+      } else {
+        return f(
+            WasmType<std::tuple_element_t<I, Args>>::load(cx, &raw[I])...);
+      }
+    };
+    if constexpr (std::is_void_v<R> || std::is_same_v<R, std::monostate>) {
+      call();
+    } else {
+      WasmTypeList<R>::store(cx, raw, call());
+    }
+  }
+
+  template <typename F>
+  static wasm_trap_t *
+  raw_callback_noexcept(void *env, wasmtime_caller_t *caller,
+                        wasmtime_val_raw_t *args_and_results,
+                        size_t nargs_and_results) noexcept {
+    using HostFunc = WasmHostFunc<F>;
+    detail::HostEnv<F> env_storage(env);
+    F *func = &env_storage.get();
+    Store::Context cx(HostFunc::needs_context ? wasmtime_caller_context(caller)
+                                              : nullptr);
+    invoke_noexcept(
+        *func, caller, cx, args_and_results,
+        std::make_index_sequence<std::tuple_size_v<typename HostFunc::Args>>());
+    return nullptr;
+  }
+
   template <typename F> static void raw_finalize(void *env) {
     std::unique_ptr<F> ptr(reinterpret_cast<F *>(env)); // NOLINT
   }
@@ -2390,7 +4336,8 @@ public:
                 bool> = true>
   Func(Store::Context cx, const FuncType &ty, F f) : func({}) {
     wasmtime_func_new(cx.ptr, ty.ptr.get(), raw_callback<F>,
-                      std::make_unique<F>(f).release(), raw_finalize<F>, &func);
+                      detail::HostEnv<F>::make(std::move(f)),
+                      detail::HostEnv<F>::finalizer, &func);
   }
 
   /**
@@ -2412,6 +4359,7 @@ public:
    * * `double` - `f64`
    * * `std::optional<Func>` - `funcref`
    * * `std::optional<ExternRef>` - `externref`
+   * * `std::optional<TypedExternRef<T>>` - `externref`
    * * `wasmtime::V128` - `v128`
    *
    * The function may only take these arguments and if it takes any other kinds
@@ -2441,8 +4389,38 @@ public:
     auto ty = FuncType::from_iters(params, results);
     wasmtime_func_t func;
     wasmtime_func_new_unchecked(cx.ptr, ty.ptr.get(), raw_callback_unchecked<F>,
-                                std::make_unique<F>(f).release(),
-                                raw_finalize<F>, &func);
+                                detail::HostEnv<F>::make(std::move(f)),
+                                detail::HostEnv<F>::finalizer, &func);
+    return func;
+  }
+
+  /**
+   * \brief Creates a new host function from `f` like `wrap`, for callables
+   * which can never trap.
+   *
+   * `f` takes the same arguments as with `wrap` but must not return a
+   * `Result`. In exchange the call is compiled into a straight-line trampoline
+   * which unpacks arguments directly from the raw WebAssembly values, stores
+   * the return value without checking for a trap, and doesn't look up the
+   * store context unless `f` takes a `Caller` or a reference type needs it.
+   * This is intended for small functions called at very high frequency.
+   *
+   * The callable must not throw; an exception escaping `f` terminates the
+   * program.
+   */
+  template <typename F,
+            std::enable_if_t<WasmHostFunc<F>::Params::valid, bool> = true,
+            std::enable_if_t<WasmHostFunc<F>::Results::valid, bool> = true,
+            std::enable_if_t<WasmHostFunc<F>::infallible, bool> = true>
+  static Func wrap_noexcept(Store::Context cx, F f) {
+    using HostFunc = WasmHostFunc<F>;
+    auto params = HostFunc::Params::types();
+    auto results = HostFunc::Results::types();
+    auto ty = FuncType::from_iters(params, results);
+    wasmtime_func_t func;
+    wasmtime_func_new_unchecked(cx.ptr, ty.ptr.get(), raw_callback_noexcept<F>,
+                                detail::HostEnv<F>::make(std::move(f)),
+                                detail::HostEnv<F>::finalizer, &func);
     return func;
   }
 
@@ -2466,7 +4444,10 @@ public:
    * > signature is statically known it's recommended to use `Func::typed` and
    * > `TypedFunc::call`.
    */
-  template <typename I>
+  template <typename I,
+            std::enable_if_t<
+                std::is_same_v<std::decay_t<decltype(*std::declval<I>())>, Val>,
+                bool> = true>
   TrapResult<std::vector<Val>> call(Store::Context cx, const I &begin,
                                     const I &end) const {
     std::vector<wasmtime_val_t> raw_params;
@@ -2474,7 +4455,7 @@ public:
     for (auto i = begin; i != end; i++) {
       raw_params.push_back(i->val);
     }
-    size_t nresults = this->type(cx)->results().size();
+    size_t nresults = this->result_count(cx);
     std::vector<wasmtime_val_t> raw_results(nresults);
 
     wasm_trap_t *trap = nullptr;
@@ -2498,7 +4479,12 @@ public:
 
   TrapResult<std::vector<Val>> call(Store::Context cx,
                                     const std::vector<Val> &params) const {
-    return this->call(cx, params.begin(), params.end());
+    std::vector<Val> results(this->result_count(cx));
+    auto result = this->call(cx, Span<const Val>(params), Span<Val>(results));
+    if (!result) {
+      return result.err();
+    }
+    return results;
   }
 
   TrapResult<std::vector<Val>>
@@ -2506,11 +4492,65 @@ public:
     return this->call(cx, params.begin(), params.end());
   }
 
+  /**
+   * \brief Invoke a WebAssembly function with caller-provided storage for
+   * its results.
+   *
+   * This is the same as the other `call` overloads except that no memory is
+   * allocated on the host. The `params` are passed directly to the function
+   * and the results of the function are written into `results`, which must
+   * have exactly as many elements as this function has results (see
+   * `result_count`). Any previous contents of `results` are overwritten, so if
+   * they were rooted GC references they should be unrooted beforehand.
+   *
+   * An `Error` is returned if `params` don't match the function's signature or
+   * if `results` has the wrong length. A `Trap` is returned if the WebAssembly
+   * function traps.
+   */
+  TrapResult<std::monostate> call(Store::Context cx, Span<const Val> params,
+                                  Span<Val> results) const {
+    static_assert(alignof(Val) == alignof(wasmtime_val_t));
+    static_assert(sizeof(Val) == sizeof(wasmtime_val_t));
+    wasm_trap_t *trap = nullptr;
+    auto *error = wasmtime_func_call(
+        cx.ptr, &func,
+        reinterpret_cast<const wasmtime_val_t *>(params.data()), // NOLINT
+        params.size(),
+        reinterpret_cast<wasmtime_val_t *>(results.data()), // NOLINT
+        results.size(), &trap);
+    if (error != nullptr) {
+      return TrapError(Error(error));
+    }
+    if (trap != nullptr) {
+      return TrapError(Trap(trap));
+    }
+    return std::monostate();
+  }
+
+#ifdef WASMTIME_FEATURE_ASYNC
+  /// \brief Starts an asynchronous call of this function with `params`.
+  ///
+  /// Requires `Config::async_support`. Nothing runs until the returned
+  /// `CallFuture` is polled or awaited. An `Error` is produced if `params`
+  /// don't match the function's signature.
+  CallFuture<std::vector<Val>> call_async(Store::Context cx,
+                                          std::vector<Val> params) const;
+#endif
+
   /// Returns the type of this function.
   FuncType type(Store::Context cx) const {
     return wasmtime_func_type(cx.ptr, &func);
   }
 
+  /// Returns the number of results this function produces.
+  ///
+  /// This only depends on the type of this function, so callers invoking the
+  /// same function many times can compute this once and reuse it to size the
+  /// `results` passed to `call`.
+  size_t result_count(Store::Context cx) const {
+    return this->type(cx)->results().size();
+  }
+
   /**
    * \brief Statically checks this function against the provided types.
    *
@@ -2541,7 +4581,22 @@ public:
     return ret;
   }
 
-  /// Returns the raw underlying C API function this is using.
+  /**
+   * \brief Checks this function against a dynamically known type and returns
+   * a reusable handle for calling it.
+   *
+   * This is intended for callers which only learn the signature of a function
+   * at runtime and so can't use `typed`, but which call the same function
+   * many times. The type check against `ty` happens once here and the returned
+   * `PreparedCall` can then call this function without re-fetching its type
+   * or allocating. See `PreparedCall` for more information.
+   *
+   * Returns a `Trap` if `ty` does not match the actual type of this function.
+   */
+  Result<PreparedCall, Trap> prepare(Store::Context cx,
+                                     const FuncType &ty) const;
+
+  /// Returns the raw underlying C API function this is using.
   const wasmtime_func_t &raw_func() const { return func; }
 };
 
@@ -2585,6 +4640,56 @@ public:
     return WasmTypeList<Results>::load(cx, ptr);
   }
 
+  /**
+   * \brief Calls this function once for each element of `params`.
+   *
+   * This is equivalent to calling `call` in a loop, writing the result of the
+   * `i`th call to `results[i]`, except that the raw argument storage and trap
+   * slot are shared across the whole batch. The `results` span must be at
+   * least as long as `params`; otherwise nothing is called and the returned
+   * `CallManyError` has the index `results.size()`, the first call whose
+   * result would have nowhere to go.
+   *
+   * Execution stops at the first call which traps or fails, in which case the
+   * returned `CallManyError` contains the index of that call. All results
+   * before that index have been written.
+   */
+  Result<std::monostate, CallManyError>
+  call_many(Store::Context cx, Span<const Params> params,
+            Span<Results> results) const {
+    if (results.size() < params.size()) {
+      return CallManyError{results.size(),
+                           TrapError(Error(wasmtime_error_new(
+                               "results shorter than params")))};
+    }
+    std::array<wasmtime_val_raw_t, std::max(WasmTypeList<Params>::size,
+                                            WasmTypeList<Results>::size)>
+        storage;
+    wasmtime_val_raw_t *ptr = storage.data();
+    if (ptr == nullptr)
+      ptr = reinterpret_cast<wasmtime_val_raw_t*>(alignof(wasmtime_val_raw_t));
+    wasm_trap_t *trap = nullptr;
+    for (size_t i = 0; i < params.size(); i++) {
+      WasmTypeList<Params>::store(cx, ptr, params[i]);
+      auto *error = wasmtime_func_call_unchecked(
+          cx.raw_context(), &f.func, ptr, storage.size(), &trap);
+      if (error != nullptr) {
+        return CallManyError{i, TrapError(Error(error))};
+      }
+      if (trap != nullptr) {
+        return CallManyError{i, TrapError(Trap(trap))};
+      }
+      results[i] = WasmTypeList<Results>::load(cx, ptr);
+    }
+    return std::monostate();
+  }
+
+#ifdef WASMTIME_FEATURE_ASYNC
+  /// \brief Starts an asynchronous call of this function, see
+  /// `Func::call_async`.
+  CallFuture<Results> call_async(Store::Context cx, const Params &params) const;
+#endif
+
   /// Returns the underlying un-typed `Func` for this function.
   const Func &func() const { return f; }
 };
@@ -2637,6 +4742,170 @@ template <> struct detail::WasmType<std::optional<Func>> {
   }
 };
 
+/**
+ * \brief A reusable handle for calling a `Func` whose type is only known at
+ * runtime.
+ *
+ * A `PreparedCall` is created with `Func::prepare` which checks the function's
+ * type once. The handle owns pre-sized storage for the raw arguments and
+ * results of the function and `call` uses `wasmtime_func_call_unchecked`,
+ * which means that calls are close in cost to `TypedFunc::call` while still
+ * taking and returning dynamically typed `Val`s.
+ *
+ * A `PreparedCall` is not safe to use concurrently from multiple threads since
+ * its storage is reused for each call, but it can be reused for any number of
+ * sequential calls.
+ */
+class PreparedCall {
+  friend class Func;
+
+  Func f;
+  std::vector<ValKind> kinds;
+  size_t nparams;
+  std::vector<wasmtime_val_raw_t> storage;
+
+  PreparedCall(Func f, std::vector<ValKind> kinds, size_t nparams)
+      : f(f), kinds(std::move(kinds)), nparams(nparams),
+        // Always keep at least one slot so `storage.data()` is never null.
+        storage(std::max<size_t>(
+            {1, nparams, this->kinds.size() - nparams})) {}
+
+  static void store(Store::Context cx, wasmtime_val_raw_t *raw,
+                    const wasmtime_val_t &val) {
+    switch (val.kind) {
+    case WASMTIME_I32:
+      raw->i32 = val.of.i32;
+      break;
+    case WASMTIME_I64:
+      raw->i64 = val.of.i64;
+      break;
+    case WASMTIME_F32:
+      raw->f32 = val.of.f32;
+      break;
+    case WASMTIME_F64:
+      raw->f64 = val.of.f64;
+      break;
+    case WASMTIME_V128:
+      memcpy(&raw->v128[0], &val.of.v128[0], sizeof(wasmtime_v128));
+      break;
+    case WASMTIME_FUNCREF:
+      raw->funcref = val.of.funcref.store_id == 0
+                         ? nullptr
+                         : wasmtime_func_to_raw(cx.raw_context(),
+                                                &val.of.funcref);
+      break;
+    case WASMTIME_EXTERNREF:
+      raw->externref = val.of.externref.store_id == 0
+                           ? 0
+                           : wasmtime_externref_to_raw(cx.raw_context(),
+                                                       &val.of.externref);
+      break;
+    default:
+      std::abort();
+    }
+  }
+
+  static Val load(Store::Context cx, wasmtime_val_raw_t *raw, ValKind kind) {
+    switch (kind) {
+    case ValKind::I32:
+      return raw->i32;
+    case ValKind::I64:
+      return raw->i64;
+    case ValKind::F32:
+      return raw->f32;
+    case ValKind::F64:
+      return raw->f64;
+    case ValKind::V128:
+      return V128(raw->v128);
+    case ValKind::FuncRef:
+      return WasmType<std::optional<Func>>::load(cx, raw);
+    case ValKind::ExternRef:
+      return WasmType<std::optional<ExternRef>>::load(cx, raw);
+    }
+    std::abort();
+  }
+
+public:
+  /**
+   * \brief Calls the prepared function.
+   *
+   * The `params` must have the number and types of parameters that this
+   * function was prepared with, and `results` must have room for exactly as
+   * many results as the function returns. Results are written into `results`,
+   * overwriting any previous contents. This performs no host allocation.
+   *
+   * Returns an `Error` if `params` or `results` don't match the prepared
+   * signature, or a `Trap` if the WebAssembly function traps.
+   */
+  TrapResult<std::monostate> call(Store::Context cx, Span<const Val> params,
+                                  Span<Val> results) {
+    if (params.size() != nparams ||
+        results.size() != kinds.size() - nparams) {
+      return TrapError(
+          Error(wasmtime_error_new("wrong number of params or results")));
+    }
+    for (size_t i = 0; i < nparams; i++) {
+      if (params[i].kind() != kinds[i]) {
+        return TrapError(Error(wasmtime_error_new("argument type mismatch")));
+      }
+      store(cx, &storage[i], params[i].val);
+    }
+    wasm_trap_t *trap = nullptr;
+    auto *error = wasmtime_func_call_unchecked(
+        cx.raw_context(), &f.raw_func(), storage.data(), storage.size(), &trap);
+    if (error != nullptr) {
+      return TrapError(Error(error));
+    }
+    if (trap != nullptr) {
+      return TrapError(Trap(trap));
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+      results[i] = load(cx, &storage[i], kinds[nparams + i]);
+    }
+    return std::monostate();
+  }
+
+  /// Returns the number of parameters the prepared function takes.
+  size_t param_count() const { return nparams; }
+
+  /// Returns the number of results the prepared function returns.
+  size_t result_count() const { return kinds.size() - nparams; }
+
+  /// Returns the underlying `Func` for this handle.
+  const Func &func() const { return f; }
+};
+
+inline Result<PreparedCall, Trap> Func::prepare(Store::Context cx,
+                                                const FuncType &ty) const {
+  auto actual = this->type(cx);
+  FuncType::Ref expected(ty);
+  auto matches = [](ValType::ListRef a, ValType::ListRef b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+      if (a.begin()[i].kind() != b.begin()[i].kind()) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (!matches(actual->params(), expected.params()) ||
+      !matches(actual->results(), expected.results())) {
+    return Trap("prepared type for this function does not match actual type");
+  }
+  std::vector<ValKind> kinds;
+  kinds.reserve(expected.params().size() + expected.results().size());
+  for (auto param : expected.params()) {
+    kinds.push_back(param.kind());
+  }
+  for (auto result : expected.results()) {
+    kinds.push_back(result.kind());
+  }
+  size_t nparams = expected.params().size();
+  return PreparedCall(*this, std::move(kinds), nparams);
+}
+
 /**
  * \brief A WebAssembly global.
  *
@@ -2727,8 +4996,18 @@ public:
    */
   static Result<Table> create(Store::Context cx, const TableType &ty,
                               const Val &init) {
+    TableType::Ref ref(ty);
+    std::optional<uint64_t> max;
+    if (auto m = ref.max()) {
+      max = *m;
+    }
+    auto charge = admit(cx, 0, ref.min(), max);
+    if (!charge) {
+      return charge.err();
+    }
     wasmtime_table_t table;
     auto *error = wasmtime_table_new(cx.ptr, ty.ptr.get(), &init.val, &table);
+    settle(cx, charge.ok(), error == nullptr);
     if (error != nullptr) {
       return Error(error);
     }
@@ -2774,17 +5053,160 @@ public:
   /// \param delta the number of new elements to be added to this table.
   /// \param init the initial value of all new elements in this table.
   ///
-  /// Returns an error if `init` has the wrong type for this table. Otherwise
-  /// returns the previous size of the table before growth.
+  /// Returns an error if `init` has the wrong type for this table, or if the
+  /// store's `ResourceLimiter` denies the growth. Otherwise returns the
+  /// previous size of the table before growth.
   Result<uint64_t> grow(Store::Context cx, uint64_t delta,
                         const Val &init) const {
+    std::optional<uint64_t> charge;
+    if (detail::StoreData::limiter_of(cx.ptr) != nullptr) {
+      uint64_t size = this->size(cx);
+      if (delta > std::numeric_limits<uint64_t>::max() - size) {
+        return Error(wasmtime_error_new("table size overflow"));
+      }
+      std::optional<uint64_t> max;
+      if (auto m = type(cx)->max()) {
+        max = *m;
+      }
+      auto result = admit(cx, size, size + delta, max);
+      if (!result) {
+        return result.err();
+      }
+      charge = result.ok();
+    }
     uint64_t prev = 0;
     auto *error = wasmtime_table_grow(cx.ptr, &table, delta, &init.val, &prev);
+    settle(cx, charge, error == nullptr);
     if (error != nullptr) {
       return Error(error);
     }
     return prev;
   }
+
+  /// Stores `val` into the `count` slots starting at `start`.
+  ///
+  /// Wasmtime's C API has no equivalent of `table.fill`, so this checks the
+  /// range once and then sets each slot with `wasmtime_table_set`.
+  ///
+  /// Returns an error, without modifying the table, if the range is out of
+  /// bounds or if `val` has the wrong type for this table.
+  Result<std::monostate> fill(Store::Context cx, uint64_t start, const Val &val,
+                              uint64_t count) const {
+    if (!in_bounds(cx, start, count)) {
+      return Error(wasmtime_error_new("table range out of bounds"));
+    }
+    for (uint64_t i = 0; i < count; i++) {
+      auto *error = wasmtime_table_set(cx.ptr, &table, start + i, &val.val);
+      if (error != nullptr) {
+        return Error(error);
+      }
+    }
+    return std::monostate();
+  }
+
+  /// Copies `count` elements from `src`, starting at `src_start`, into this
+  /// table starting at `dst_start`.
+  ///
+  /// Like `fill`, this is a loop over single-slot C API calls since there is
+  /// no equivalent of `table.copy`. `src` may be this same table, in which
+  /// case overlapping ranges are handled like `memmove`. Returns an error, without modifying the table, if
+  /// either range is out of bounds. Returns an error part way through if the
+  /// element types of the two tables differ.
+  Result<std::monostate> copy(Store::Context cx, uint64_t dst_start,
+                              const Table &src, uint64_t src_start,
+                              uint64_t count) const {
+    if (!in_bounds(cx, dst_start, count) ||
+        !src.in_bounds(cx, src_start, count)) {
+      return Error(wasmtime_error_new("table range out of bounds"));
+    }
+    bool backwards = dst_start > src_start;
+    for (uint64_t n = 0; n < count; n++) {
+      uint64_t i = backwards ? count - 1 - n : n;
+      wasmtime_val_t val;
+      wasmtime_table_get(cx.ptr, &src.table, src_start + i, &val);
+      auto *error = wasmtime_table_set(cx.ptr, &table, dst_start + i, &val);
+      wasmtime_val_unroot(cx.ptr, &val);
+      if (error != nullptr) {
+        return Error(error);
+      }
+    }
+    return std::monostate();
+  }
+
+  /// Stores each of `vals` into consecutive slots starting at `start`.
+  ///
+  /// Returns an error, without modifying the table, if the range is out of
+  /// bounds. Returns an error part way through if one of `vals` has the wrong
+  /// type, leaving the preceding slots written.
+  Result<std::monostate> set_range(Store::Context cx, uint64_t start,
+                                   Span<const Val> vals) const {
+    if (!in_bounds(cx, start, vals.size())) {
+      return Error(wasmtime_error_new("table range out of bounds"));
+    }
+    for (size_t i = 0; i < vals.size(); i++) {
+      auto *error =
+          wasmtime_table_set(cx.ptr, &table, start + i, &vals[i].val);
+      if (error != nullptr) {
+        return Error(error);
+      }
+    }
+    return std::monostate();
+  }
+
+  /// Loads `out.size()` consecutive slots starting at `start` into `out`.
+  ///
+  /// Each loaded reference is newly rooted, so the caller must `unroot` the
+  /// values once done with them. Values already in `out` are overwritten
+  /// without being unrooted, since copies of them may still be in use; unroot
+  /// them first when reusing a buffer of references.
+  ///
+  /// Returns an error, without modifying `out`, if the range is out of bounds.
+  Result<std::monostate> get_range(Store::Context cx, uint64_t start,
+                                   Span<Val> out) const {
+    if (!in_bounds(cx, start, out.size())) {
+      return Error(wasmtime_error_new("table range out of bounds"));
+    }
+    for (size_t i = 0; i < out.size(); i++) {
+      wasmtime_table_get(cx.ptr, &table, start + i, &out[i].val);
+    }
+    return std::monostate();
+  }
+
+private:
+  // Asks the store's limiter, if any, to grow a table from `current` to
+  // `desired` elements, returning the elements to charge to the store.
+  static Result<std::optional<uint64_t>>
+  admit(Store::Context cx, uint64_t current, uint64_t desired,
+        std::optional<uint64_t> maximum) {
+    auto *limiter = detail::StoreData::limiter_of(cx.ptr);
+    if (limiter == nullptr) {
+      return std::optional<uint64_t>();
+    }
+    if (!limiter->table_growing(current, desired, maximum)) {
+      return Error(wasmtime_error_new("table growth denied by limiter"));
+    }
+    return std::optional<uint64_t>(desired - current);
+  }
+
+  // Charges the elements allowed by `admit` to the store if the growth
+  // happened, or gives them back to the limiter.
+  static void settle(Store::Context cx, std::optional<uint64_t> charge,
+                     bool grown) {
+    if (!charge) {
+      return;
+    }
+    auto *data = detail::StoreData::get(cx.ptr);
+    if (grown) {
+      data->table_elements += *charge;
+    } else {
+      data->limiter->table_released(*charge);
+    }
+  }
+
+  bool in_bounds(Store::Context cx, uint64_t start, uint64_t count) const {
+    uint64_t size = wasmtime_table_size(cx.ptr, &table);
+    return start <= size && count <= size - start;
+  }
 };
 
 // gcc 8.3.0 seems to require that this comes after the definition of `Table`. I
@@ -2795,6 +5217,17 @@ inline Val Global::get(Store::Context cx) const {
   return val;
 }
 
+class MemoryView;
+
+/// \brief A range of guest linear memory, used for scatter/gather transfers
+/// with `Memory::gather`, `Memory::scatter`, and `Memory::slices`.
+struct GuestIoVec {
+  /// Byte offset of the start of the range within linear memory.
+  uint64_t offset;
+  /// Length of the range in bytes.
+  uint64_t len;
+};
+
 /**
  * \brief A WebAssembly linear memory.
  *
@@ -2808,6 +5241,7 @@ inline Val Global::get(Store::Context cx) const {
  */
 class Memory {
   friend class Instance;
+  friend class MemoryView;
   wasmtime_memory_t memory;
 
 public:
@@ -2815,9 +5249,17 @@ public:
   Memory(wasmtime_memory_t memory) : memory(memory) {}
 
   /// Creates a new host-defined memory with the type specified.
+  ///
+  /// Fails if the store's `ResourceLimiter` denies the memory's minimum size.
   static Result<Memory> create(Store::Context cx, const MemoryType &ty) {
+    MemoryType::Ref ref(ty);
+    auto charge = admit(cx, 0, ref.min(), ref.max());
+    if (!charge) {
+      return charge.err();
+    }
     wasmtime_memory_t memory;
     auto *error = wasmtime_memory_new(cx.ptr, ty.ptr.get(), &memory);
+    settle(cx, charge.ok(), error == nullptr);
     if (error != nullptr) {
       return Error(error);
     }
@@ -2848,132 +5290,654 @@ public:
   /// Grows the memory by `delta` WebAssembly pages.
   ///
   /// On success returns the previous size of this memory in units of
-  /// WebAssembly pages.
+  /// WebAssembly pages. Fails if the store's `ResourceLimiter` denies the
+  /// growth.
   Result<uint64_t> grow(Store::Context cx, uint64_t delta) const {
+    std::optional<size_t> charge;
+    if (detail::StoreData::limiter_of(cx.ptr) != nullptr) {
+      uint64_t size = wasmtime_memory_size(cx.ptr, &memory);
+      if (delta > std::numeric_limits<uint64_t>::max() - size) {
+        return Error(wasmtime_error_new("memory size overflow"));
+      }
+      auto result = admit(cx, size, size + delta, type(cx)->max());
+      if (!result) {
+        return result.err();
+      }
+      charge = result.ok();
+    }
     uint64_t prev = 0;
     auto *error = wasmtime_memory_grow(cx.ptr, &memory, delta, &prev);
+    settle(cx, charge, error == nullptr);
     if (error != nullptr) {
       return Error(error);
     }
     return prev;
   }
-};
-
-/**
- * \brief A WebAssembly instance.
- *
- * This class represents a WebAssembly instance, created by instantiating a
- * module. An instance is the collection of items exported by the module, which
- * can be accessed through the `Store` that owns the instance.
- *
- * Note that this type does not itself own any resources. It points to resources
- * owned within a `Store` and the `Store` must be passed in as the first
- * argument to the functions defined on `Instance`. Note that if the wrong
- * `Store` is passed in then the process will be aborted.
- */
-class Instance {
-  friend class Linker;
-  friend class Caller;
 
-  wasmtime_instance_t instance;
+  /// Returns a bounds-checked `MemoryView` of this memory within `cx`.
+  MemoryView view(Store::Context cx) const;
 
-  static Extern cvt(wasmtime_extern_t &e) {
-    switch (e.kind) {
-    case WASMTIME_EXTERN_FUNC:
-      return Func(e.of.func);
-    case WASMTIME_EXTERN_GLOBAL:
-      return Global(e.of.global);
-    case WASMTIME_EXTERN_MEMORY:
-      return Memory(e.of.memory);
-    case WASMTIME_EXTERN_TABLE:
-      return Table(e.of.table);
+private:
+  static constexpr uint64_t page_size = 65536;
+
+  // Asks the store's limiter, if any, to grow a memory from `current` to
+  // `desired` pages, returning the bytes to charge to the store.
+  static Result<std::optional<size_t>> admit(Store::Context cx,
+                                             uint64_t current, uint64_t desired,
+                                             std::optional<uint64_t> maximum) {
+    auto *limiter = detail::StoreData::limiter_of(cx.ptr);
+    if (limiter == nullptr) {
+      return std::optional<size_t>();
     }
-    std::abort();
+    const uint64_t limit = std::numeric_limits<size_t>::max() / page_size;
+    if (desired > limit) {
+      return Error(wasmtime_error_new("memory size overflow"));
+    }
+    std::optional<size_t> max_bytes;
+    if (maximum) {
+      max_bytes = size_t(std::min(*maximum, limit) * page_size);
+    }
+    if (!limiter->memory_growing(size_t(current * page_size),
+                                 size_t(desired * page_size), max_bytes)) {
+      return Error(wasmtime_error_new("memory growth denied by limiter"));
+    }
+    return std::optional<size_t>(size_t((desired - current) * page_size));
   }
 
-  static void cvt(const Extern &e, wasmtime_extern_t &raw) {
-    if (const auto *func = std::get_if<Func>(&e)) {
-      raw.kind = WASMTIME_EXTERN_FUNC;
-      raw.of.func = func->func;
-    } else if (const auto *global = std::get_if<Global>(&e)) {
-      raw.kind = WASMTIME_EXTERN_GLOBAL;
-      raw.of.global = global->global;
-    } else if (const auto *table = std::get_if<Table>(&e)) {
-      raw.kind = WASMTIME_EXTERN_TABLE;
-      raw.of.table = table->table;
-    } else if (const auto *memory = std::get_if<Memory>(&e)) {
-      raw.kind = WASMTIME_EXTERN_MEMORY;
-      raw.of.memory = memory->memory;
+  // Charges the bytes allowed by `admit` to the store if the growth
+  // happened, or gives them back to the limiter.
+  static void settle(Store::Context cx, std::optional<size_t> charge,
+                     bool grown) {
+    if (!charge) {
+      return;
+    }
+    auto *data = detail::StoreData::get(cx.ptr);
+    if (grown) {
+      data->memory_bytes += *charge;
     } else {
-      std::abort();
+      data->limiter->memory_released(*charge);
     }
   }
 
 public:
-  /// Creates a new instance from the raw underlying C API representation.
-  Instance(wasmtime_instance_t instance) : instance(instance) {}
+  /// \brief Copies the guest ranges `iovs`, in order, into `dst`.
+  ///
+  /// All ranges are bounds-checked before anything is copied. As with
+  /// `readv`, at most `dst.size()` bytes are copied and the number of bytes
+  /// copied is returned. Fails if any range is out of bounds.
+  Result<size_t> gather(Store::Context cx, Span<const GuestIoVec> iovs,
+                        Span<uint8_t> dst) const {
+    auto mem = data(cx);
+    if (!in_bounds(mem, iovs)) {
+      return Error(wasmtime_error_new("guest iovec out of bounds"));
+    }
+    size_t copied = 0;
+    for (const auto &iov : iovs) {
+      size_t n = std::min(size_t(iov.len), dst.size() - copied);
+      if (n != 0) {
+        memcpy(dst.data() + copied, mem.data() + iov.offset, n); // NOLINT
+      }
+      copied += n;
+    }
+    return copied;
+  }
 
-  /**
-   * \brief Instantiates the module `m` with the provided `imports`
-   *
-   * \param cx the store in which to instantiate the provided module
-   * \param m the module to instantiate
-   * \param imports the list of imports to use to instantiate the module
-   *
-   * This `imports` parameter is expected to line up 1:1 with the imports
-   * required by the `m`. The type of `m` can be inspected to determine in which
-   * order to provide the imports. Note that this is a relatively low-level API
-   * and it's generally recommended to use `Linker` instead for name-based
-   * instantiation.
-   *
-   * This function can return an error if any of the `imports` have the wrong
-   * type, or if the wrong number of `imports` is provided.
-   */
-  static TrapResult<Instance> create(Store::Context cx, const Module &m,
-                                     const std::vector<Extern> &imports) {
-    std::vector<wasmtime_extern_t> raw_imports;
-    for (const auto &item : imports) {
-      raw_imports.push_back(wasmtime_extern_t{});
-      auto &last = raw_imports.back();
-      Instance::cvt(item, last);
+  /// \brief Copies `src`, in order, into the guest ranges `iovs`.
+  ///
+  /// All ranges are bounds-checked before anything is copied. As with
+  /// `writev`, copying stops once `src` is exhausted and the number of bytes
+  /// copied is returned. Fails if any range is out of bounds.
+  Result<size_t> scatter(Store::Context cx, Span<const uint8_t> src,
+                         Span<const GuestIoVec> iovs) const {
+    auto mem = data(cx);
+    if (!in_bounds(mem, iovs)) {
+      return Error(wasmtime_error_new("guest iovec out of bounds"));
     }
-    wasmtime_instance_t instance;
-    wasm_trap_t *trap = nullptr;
-    auto *error = wasmtime_instance_new(cx.ptr, m.ptr.get(), raw_imports.data(),
-                                        raw_imports.size(), &instance, &trap);
-    if (error != nullptr) {
-      return TrapError(Error(error));
+    size_t copied = 0;
+    for (const auto &iov : iovs) {
+      size_t n = std::min(size_t(iov.len), src.size() - copied);
+      if (n != 0) {
+        memcpy(mem.data() + iov.offset, src.data() + copied, n); // NOLINT
+      }
+      copied += n;
     }
-    if (trap != nullptr) {
-      return TrapError(Trap(trap));
+    return copied;
+  }
+
+  /// \brief Resolves the guest ranges `iovs` to host spans pointing directly
+  /// into linear memory, written to the front of `out`.
+  ///
+  /// This allows handing guest buffers to vectored host I/O such as `writev`
+  /// without an intermediate copy. The spans aren't laid out like a
+  /// `struct iovec`, so convert each into one with
+  /// `{span.data(), span.size()}` before the call. All ranges are
+  /// bounds-checked, and this fails if any is out of bounds or if `out` is
+  /// shorter than `iovs`. The returned spans have the same lifetime caveats as
+  /// `data`; they're invalidated by `grow` and by calls into WebAssembly.
+  Result<std::monostate> slices(Store::Context cx, Span<const GuestIoVec> iovs,
+                                Span<Span<uint8_t>> out) const {
+    if (out.size() < iovs.size()) {
+      return Error(wasmtime_error_new("output span too small"));
     }
-    return Instance(instance);
+    auto mem = data(cx);
+    if (!in_bounds(mem, iovs)) {
+      return Error(wasmtime_error_new("guest iovec out of bounds"));
+    }
+    for (size_t i = 0; i < iovs.size(); i++) {
+      out[i] = Span<uint8_t>(mem.data() + iovs[i].offset, // NOLINT
+                             size_t(iovs[i].len));
+    }
+    return std::monostate();
   }
 
-  /**
-   * \brief Load an instance's export by name.
-   *
-   * This function will look for an export named `name` on this instance and, if
-   * found, return it as an `Extern`.
-   */
-  std::optional<Extern> get(Store::Context cx, std::string_view name) {
-    wasmtime_extern_t e;
-    if (!wasmtime_instance_export_get(cx.ptr, &instance, name.data(),
-                                      name.size(), &e)) {
-      return std::nullopt;
+private:
+  // Checks that every range in `iovs` lies within `mem`.
+  static bool in_bounds(Span<uint8_t> mem, Span<const GuestIoVec> iovs) {
+    for (const auto &iov : iovs) {
+      if (iov.offset > mem.size() || iov.len > mem.size() - iov.offset) {
+        return false;
+      }
     }
-    return Instance::cvt(e);
+    return true;
   }
+};
 
-  /**
-   * \brief Load an instance's export by index.
-   *
-   * This function will look for the `idx`th export of this instance. This will
-   * return both the name of the export as well as the exported item itself.
-   */
-  std::optional<std::pair<std::string_view, Extern>> get(Store::Context cx,
-                                                         size_t idx) {
-    wasmtime_extern_t e;
+/**
+ * \brief A bounds-checked view of a `Memory` for bulk host reads and writes.
+ *
+ * Pointers into linear memory are invalidated when the memory grows, either
+ * through `Memory::grow` or from WebAssembly itself. A `MemoryView` caches
+ * the memory's base pointer and length and re-validates them before every
+ * access with a single call to `wasmtime_memory_data_size`, so it stays valid
+ * across calls into WebAssembly while each range is only bounds-checked once.
+ *
+ * Values are copied in host byte order. WebAssembly memory is little-endian,
+ * so callers on big-endian hosts need to byte-swap multi-byte values.
+ *
+ * A `MemoryView` borrows the `Store::Context` it was created with and must not
+ * outlive it.
+ */
+class MemoryView {
+  Store::Context cx;
+  Memory memory;
+  uint8_t *base;
+  size_t len;
+
+  // Linear memories never shrink and only move when they grow, so an
+  // unchanged length means the cached base pointer is still valid.
+  void revalidate() {
+    size_t current = wasmtime_memory_data_size(cx.ptr, &memory.memory);
+    if (current != len) {
+      base = wasmtime_memory_data(cx.ptr, &memory.memory);
+      len = current;
+    }
+  }
+
+  // Returns a pointer to `bytes` bytes at `offset`, or `nullptr` if any part of
+  // that range is out of bounds.
+  uint8_t *range(uint64_t offset, uint64_t bytes) {
+    revalidate();
+    if (offset > len || bytes > len - offset) {
+      return nullptr;
+    }
+    return base + offset; // NOLINT
+  }
+
+public:
+  /// Creates a view of `memory` within the store `cx`.
+  MemoryView(Store::Context cx, Memory memory)
+      : cx(cx), memory(memory),
+        base(wasmtime_memory_data(cx.ptr, &this->memory.memory)),
+        len(wasmtime_memory_data_size(cx.ptr, &this->memory.memory)) {}
+
+  /// Returns the current size of the memory, in bytes.
+  size_t size() {
+    revalidate();
+    return len;
+  }
+
+  /// \brief Reads a `T` from `offset`, returning `std::nullopt` if it would be
+  /// out of bounds.
+  ///
+  /// The `offset` doesn't need to be aligned.
+  template <typename T> std::optional<T> read(uint64_t offset) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "only trivially copyable types can be read from memory");
+    const uint8_t *src = range(offset, sizeof(T));
+    if (src == nullptr) {
+      return std::nullopt;
+    }
+    T value;
+    memcpy(&value, src, sizeof(T));
+    return value;
+  }
+
+  /// \brief Writes `value` to `offset`, returning `false` if it would be out of
+  /// bounds.
+  ///
+  /// The `offset` doesn't need to be aligned.
+  template <typename T>
+  [[nodiscard]] bool write(uint64_t offset, const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "only trivially copyable types can be written to memory");
+    uint8_t *dst = range(offset, sizeof(T));
+    if (dst == nullptr) {
+      return false;
+    }
+    memcpy(dst, &value, sizeof(T));
+    return true;
+  }
+
+  /// \brief Returns a span of `count` values of type `T` starting at `offset`.
+  ///
+  /// Returns `std::nullopt` if the range is out of bounds or if `offset` is not
+  /// suitably aligned for `T`. The whole range is checked once, so the span can
+  /// then be accessed without further checks. Like `Memory::data`, the
+  /// returned span is invalidated when the memory grows or WebAssembly is
+  /// called.
+  template <typename T>
+  std::optional<Span<T>> span(uint64_t offset, size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "only trivially copyable types can be viewed in memory");
+    if (offset % alignof(T) != 0 ||
+        count > std::numeric_limits<uint64_t>::max() / sizeof(T)) {
+      return std::nullopt;
+    }
+    uint8_t *start = range(offset, uint64_t(count) * sizeof(T));
+    if (start == nullptr) {
+      return std::nullopt;
+    }
+    return Span<T>(reinterpret_cast<T *>(start), count); // NOLINT
+  }
+
+  /// \brief Copies `src` into memory at `offset`, returning `false` without
+  /// copying anything if the destination range is out of bounds.
+  [[nodiscard]] bool copy_in(uint64_t offset, Span<const uint8_t> src) {
+    uint8_t *dst = range(offset, src.size());
+    if (dst == nullptr) {
+      return false;
+    }
+    if (src.size() != 0) {
+      memcpy(dst, src.data(), src.size());
+    }
+    return true;
+  }
+
+  /// \brief Copies memory at `offset` into `dst`, returning `false` without
+  /// copying anything if the source range is out of bounds.
+  [[nodiscard]] bool copy_out(uint64_t offset, Span<uint8_t> dst) {
+    const uint8_t *src = range(offset, dst.size());
+    if (src == nullptr) {
+      return false;
+    }
+    if (dst.size() != 0) {
+      memcpy(dst.data(), src, dst.size());
+    }
+    return true;
+  }
+};
+
+inline MemoryView Memory::view(Store::Context cx) const {
+  return MemoryView(cx, *this);
+}
+
+/**
+ * \brief A WebAssembly shared linear memory.
+ *
+ * Unlike `Memory`, a `SharedMemory` isn't owned by any `Store`: it belongs to
+ * an `Engine` and can be imported into instances living in many stores at
+ * once, for example one store per worker thread. This type is a thread-safe
+ * reference-counted handle, so copies refer to the same memory and can be
+ * freely sent to and used from other threads.
+ *
+ * Shared memories require `Config::wasm_threads` to be enabled and a shared
+ * `MemoryType`, created with `MemoryType::NewShared`.
+ *
+ * A `SharedMemory` isn't an `Extern`. It's imported with the `SharedMemory`
+ * overloads of `ImportList::push_back` and `Linker::define`, and exports are
+ * loaded with `Instance::get_shared_memory`.
+ *
+ * Note that other threads may be reading and writing the memory concurrently,
+ * so host accesses through `data` need to be synchronized with the guest just
+ * like accesses from any other thread, for example with atomics.
+ */
+class SharedMemory {
+  friend class Instance;
+  friend class ImportList;
+  friend class Linker;
+
+  struct deleter {
+    void operator()(wasmtime_sharedmemory_t *p) const {
+      wasmtime_sharedmemory_delete(p);
+    }
+  };
+
+  std::unique_ptr<wasmtime_sharedmemory_t, deleter> ptr;
+
+  SharedMemory(wasmtime_sharedmemory_t *raw) : ptr(raw) {}
+
+public:
+  /// Creates another handle to the same shared memory.
+  SharedMemory(const SharedMemory &other)
+      : ptr(wasmtime_sharedmemory_clone(other.ptr.get())) {}
+  /// Creates another handle to the same shared memory.
+  SharedMemory &operator=(const SharedMemory &other) {
+    ptr.reset(wasmtime_sharedmemory_clone(other.ptr.get()));
+    return *this;
+  }
+  ~SharedMemory() = default;
+  /// Moves resources from another handle into this one.
+  SharedMemory(SharedMemory &&other) = default;
+  /// Moves resources from another handle into this one.
+  SharedMemory &operator=(SharedMemory &&other) = default;
+
+  /// Creates a new shared memory of type `ty` within `engine`.
+  static Result<SharedMemory> create(Engine &engine, const MemoryType &ty) {
+    wasmtime_sharedmemory_t *raw = nullptr;
+    auto *error =
+        wasmtime_sharedmemory_new(engine.ptr.get(), ty.ptr.get(), &raw);
+    if (error != nullptr) {
+      return Error(error);
+    }
+    return SharedMemory(raw);
+  }
+
+  /// Returns the type of this memory.
+  MemoryType type() const { return wasmtime_sharedmemory_type(ptr.get()); }
+
+  /// Returns the size, in WebAssembly pages, of this memory.
+  uint64_t size() const { return wasmtime_sharedmemory_size(ptr.get()); }
+
+  /// \brief Returns a `span` of where this memory is located in the host.
+  ///
+  /// Shared memories never move, so the returned span stays valid for as long
+  /// as this memory is alive, but it doesn't cover memory added by a later
+  /// `grow`.
+  Span<uint8_t> data() const {
+    auto *base = wasmtime_sharedmemory_data(ptr.get());
+    auto size = wasmtime_sharedmemory_data_size(ptr.get());
+    return {base, size};
+  }
+
+  /// Grows the memory by `delta` WebAssembly pages.
+  ///
+  /// On success returns the previous size of this memory in units of
+  /// WebAssembly pages.
+  Result<uint64_t> grow(uint64_t delta) const {
+    uint64_t prev = 0;
+    auto *error = wasmtime_sharedmemory_grow(ptr.get(), delta, &prev);
+    if (error != nullptr) {
+      return Error(error);
+    }
+    return prev;
+  }
+};
+
+/**
+ * \brief The names of a module's exports, resolved once to positions.
+ *
+ * Every instance of a module has the same exports in the same order, so an
+ * `ExportIndex` computed from a `Module` can be shared by all of its
+ * instances. `Instance::exports` then loads all exports of an instance in one
+ * pass, and looking up an export becomes indexing into that list at a
+ * position found with `find` ahead of time.
+ */
+class ExportIndex {
+  std::vector<std::string> names;
+  // Positions into `names`, sorted by name.
+  std::vector<size_t> sorted;
+
+public:
+  /// Creates an index of the exports of `m`.
+  explicit ExportIndex(const Module &m) {
+    auto exports = m.exports();
+    names.reserve(exports.size());
+    for (auto ty : exports) {
+      names.emplace_back(ty.name());
+    }
+    sorted.resize(names.size());
+    for (size_t i = 0; i < sorted.size(); i++) {
+      sorted[i] = i;
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [&](size_t a, size_t b) { return names[a] < names[b]; });
+  }
+
+  /// Returns the number of exports.
+  size_t size() const { return names.size(); }
+
+  /// Returns the name of the export at position `idx`.
+  std::string_view name(size_t idx) const { return names.at(idx); }
+
+  /// Returns the position of the export called `name`, if there is one.
+  std::optional<size_t> find(std::string_view name) const {
+    auto it = std::lower_bound(
+        sorted.begin(), sorted.end(), name,
+        [&](size_t idx, std::string_view key) { return names[idx] < key; });
+    if (it == sorted.end() || names[*it] != name) {
+      return std::nullopt;
+    }
+    return *it;
+  }
+};
+
+/**
+ * \brief A list of imports converted once to their C API representation.
+ *
+ * `Instance::create` normally converts each `Extern` every time it's called.
+ * An `ImportList` holds the converted values instead, so instantiating many
+ * times with the same imports skips the conversion and the allocation. Items
+ * belong to one store, so when instantiating into a new store only the
+ * entries that differ need to be replaced with `set`, and the list's storage
+ * is reused.
+ *
+ * An `ImportList` is also how shared memories are imported. It doesn't keep a
+ * `SharedMemory` alive, the `SharedMemory` it was given must outlive its use.
+ */
+class ImportList {
+  std::vector<wasmtime_extern_t> items;
+
+public:
+  /// Creates an empty list.
+  ImportList() = default;
+
+  /// Creates a list of `imports`.
+  ImportList(const std::vector<Extern> &imports);
+
+  /// Reserves space for `n` imports.
+  void reserve(size_t n) { items.reserve(n); }
+
+  /// Appends `item` to the list.
+  void push_back(const Extern &item);
+
+  /// Appends the shared memory `item` to the list.
+  void push_back(const SharedMemory &item) {
+    cvt(item, items.emplace_back());
+  }
+
+  /// Replaces the import at position `idx` with `item`.
+  void set(size_t idx, const Extern &item);
+
+  /// Replaces the import at position `idx` with the shared memory `item`.
+  void set(size_t idx, const SharedMemory &item) { cvt(item, items.at(idx)); }
+
+  /// Removes all imports, keeping the allocated storage.
+  void clear() { items.clear(); }
+
+  /// Returns the number of imports.
+  size_t size() const { return items.size(); }
+
+  /// Returns the imports in their C API representation.
+  Span<const wasmtime_extern_t> raw() const {
+    return {items.data(), items.size()};
+  }
+
+private:
+  static void cvt(const SharedMemory &item, wasmtime_extern_t &raw) {
+    raw.kind = WASMTIME_EXTERN_SHAREDMEMORY;
+    raw.of.sharedmemory = item.ptr.get();
+  }
+};
+
+/**
+ * \brief A WebAssembly instance.
+ *
+ * This class represents a WebAssembly instance, created by instantiating a
+ * module. An instance is the collection of items exported by the module, which
+ * can be accessed through the `Store` that owns the instance.
+ *
+ * Note that this type does not itself own any resources. It points to resources
+ * owned within a `Store` and the `Store` must be passed in as the first
+ * argument to the functions defined on `Instance`. Note that if the wrong
+ * `Store` is passed in then the process will be aborted.
+ */
+class Instance {
+  friend class Linker;
+  friend class Caller;
+  friend class ImportList;
+
+  wasmtime_instance_t instance;
+
+  // Shared memories aren't an `Extern`, so for those this releases the handle
+  // the C API returned and yields `std::nullopt`.
+  static std::optional<Extern> cvt(wasmtime_extern_t &e) {
+    switch (e.kind) {
+    case WASMTIME_EXTERN_FUNC:
+      return Func(e.of.func);
+    case WASMTIME_EXTERN_GLOBAL:
+      return Global(e.of.global);
+    case WASMTIME_EXTERN_MEMORY:
+      return Memory(e.of.memory);
+    case WASMTIME_EXTERN_TABLE:
+      return Table(e.of.table);
+    case WASMTIME_EXTERN_SHAREDMEMORY:
+      wasmtime_sharedmemory_delete(e.of.sharedmemory);
+      return std::nullopt;
+    }
+    std::abort();
+  }
+
+  static void cvt(const Extern &e, wasmtime_extern_t &raw) {
+    if (const auto *func = std::get_if<Func>(&e)) {
+      raw.kind = WASMTIME_EXTERN_FUNC;
+      raw.of.func = func->func;
+    } else if (const auto *global = std::get_if<Global>(&e)) {
+      raw.kind = WASMTIME_EXTERN_GLOBAL;
+      raw.of.global = global->global;
+    } else if (const auto *table = std::get_if<Table>(&e)) {
+      raw.kind = WASMTIME_EXTERN_TABLE;
+      raw.of.table = table->table;
+    } else if (const auto *memory = std::get_if<Memory>(&e)) {
+      raw.kind = WASMTIME_EXTERN_MEMORY;
+      raw.of.memory = memory->memory;
+    } else {
+      std::abort();
+    }
+  }
+
+public:
+  /// Creates a new instance from the raw underlying C API representation.
+  Instance(wasmtime_instance_t instance) : instance(instance) {}
+
+  /**
+   * \brief Instantiates the module `m` with the provided `imports`
+   *
+   * \param cx the store in which to instantiate the provided module
+   * \param m the module to instantiate
+   * \param imports the list of imports to use to instantiate the module
+   *
+   * This `imports` parameter is expected to line up 1:1 with the imports
+   * required by the `m`. The type of `m` can be inspected to determine in which
+   * order to provide the imports. Note that this is a relatively low-level API
+   * and it's generally recommended to use `Linker` instead for name-based
+   * instantiation.
+   *
+   * This function can return an error if any of the `imports` have the wrong
+   * type, or if the wrong number of `imports` is provided.
+   */
+  static TrapResult<Instance> create(Store::Context cx, const Module &m,
+                                     const std::vector<Extern> &imports) {
+    std::vector<wasmtime_extern_t> raw_imports(imports.size());
+    for (size_t i = 0; i < imports.size(); i++) {
+      Instance::cvt(imports[i], raw_imports[i]);
+    }
+    return create(cx, m, Span<const wasmtime_extern_t>(raw_imports));
+  }
+
+  /// \brief Instantiates the module `m` with the provided `imports`, which are
+  /// the same as for the `std::vector` overload.
+  static TrapResult<Instance> create(Store::Context cx, const Module &m,
+                                     std::initializer_list<Extern> imports) {
+    return create(cx, m, std::vector<Extern>(imports));
+  }
+
+  /// \brief Instantiates the module `m` with `imports` which have already
+  /// been converted, avoiding any per-import work or allocation.
+  static TrapResult<Instance> create(Store::Context cx, const Module &m,
+                                     const ImportList &imports) {
+    return create(cx, m, imports.raw());
+  }
+
+  /// \brief Instantiates the module `m` with `imports` in their raw C API
+  /// representation.
+  static TrapResult<Instance> create(Store::Context cx, const Module &m,
+                                     Span<const wasmtime_extern_t> imports) {
+    wasmtime_instance_t instance;
+    wasm_trap_t *trap = nullptr;
+    auto *error = wasmtime_instance_new(cx.ptr, m.ptr.get(), imports.data(),
+                                        imports.size(), &instance, &trap);
+    if (error != nullptr) {
+      return TrapError(Error(error));
+    }
+    if (trap != nullptr) {
+      return TrapError(Trap(trap));
+    }
+    return Instance(instance);
+  }
+
+  /**
+   * \brief Load an instance's export by name.
+   *
+   * This function will look for an export named `name` on this instance and, if
+   * found, return it as an `Extern`. Shared memories aren't returned, use
+   * `get_shared_memory` for those.
+   */
+  std::optional<Extern> get(Store::Context cx, std::string_view name) {
+    wasmtime_extern_t e;
+    if (!wasmtime_instance_export_get(cx.ptr, &instance, name.data(),
+                                      name.size(), &e)) {
+      return std::nullopt;
+    }
+    return Instance::cvt(e);
+  }
+
+  /// \brief Loads the shared memory exported as `name`, returning
+  /// `std::nullopt` if there's no such export or it isn't a shared memory.
+  std::optional<SharedMemory> get_shared_memory(Store::Context cx,
+                                                std::string_view name) {
+    wasmtime_extern_t e;
+    if (!wasmtime_instance_export_get(cx.ptr, &instance, name.data(),
+                                      name.size(), &e)) {
+      return std::nullopt;
+    }
+    if (e.kind != WASMTIME_EXTERN_SHAREDMEMORY) {
+      return std::nullopt;
+    }
+    // Ownership of shared memories is transferred out of the C API.
+    return SharedMemory(e.of.sharedmemory);
+  }
+
+  /**
+   * \brief Load an instance's export by index.
+   *
+   * This function will look for the `idx`th export of this instance. This will
+   * return both the name of the export as well as the exported item itself,
+   * which may be a `SharedMemory`. Returns `std::nullopt` only if `idx` is out
+   * of bounds, so every export can be visited by counting up from zero.
+   */
+  std::optional<std::pair<std::string_view, ExportItem>>
+  get(Store::Context cx, size_t idx) {
+    wasmtime_extern_t e;
     // I'm not sure why clang-tidy thinks this is using va_list or anything
     // related to that...
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
@@ -2983,19 +5947,1372 @@ public:
                                       &e)) {
       return std::nullopt;
     }
-    std::string_view n(name, len);
-    return std::pair(n, Instance::cvt(e));
+    std::string_view n(name, len);
+    if (e.kind == WASMTIME_EXTERN_SHAREDMEMORY) {
+      // Ownership of shared memories is transferred out of the C API.
+      return std::pair(n, ExportItem(SharedMemory(e.of.sharedmemory)));
+    }
+    auto item = *Instance::cvt(e);
+    return std::pair(
+        n, std::visit([](auto &&x) { return ExportItem(std::move(x)); },
+                      std::move(item)));
+  }
+
+  /**
+   * \brief Loads all of this instance's exports, in the order of `index`.
+   *
+   * `index` must have been computed from the module this instance was
+   * created from. The export at position `i` of the returned list is the one
+   * named `index.name(i)`. Fails if the instance's exports don't match
+   * `index`, or if any export is a shared memory, which isn't an `Extern`.
+   */
+  Result<std::vector<Extern>> exports(Store::Context cx,
+                                      const ExportIndex &index) const {
+    std::vector<Extern> ret;
+    ret.reserve(index.size());
+    auto mismatch = [] {
+      return Error(
+          wasmtime_error_new("instance doesn't match the export index"));
+    };
+    wasmtime_extern_t e;
+    char *name = nullptr;
+    size_t len = 0;
+    for (size_t i = 0; i < index.size(); i++) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+      if (!wasmtime_instance_export_nth(cx.ptr, &instance, i, &name, &len,
+                                        &e)) {
+        return mismatch();
+      }
+      auto item = Instance::cvt(e);
+      if (std::string_view(name, len) != index.name(i)) {
+        return mismatch();
+      }
+      if (!item) {
+        return Error(wasmtime_error_new("export is a shared memory"));
+      }
+      ret.push_back(std::move(*item));
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    if (wasmtime_instance_export_nth(cx.ptr, &instance, index.size(), &name,
+                                     &len, &e)) {
+      Instance::cvt(e);
+      return mismatch();
+    }
+    return ret;
+  }
+};
+
+inline ImportList::ImportList(const std::vector<Extern> &imports)
+    : items(imports.size()) {
+  for (size_t i = 0; i < imports.size(); i++) {
+    Instance::cvt(imports[i], items[i]);
+  }
+}
+
+inline void ImportList::push_back(const Extern &item) {
+  Instance::cvt(item, items.emplace_back());
+}
+
+inline void ImportList::set(size_t idx, const Extern &item) {
+  Instance::cvt(item, items.at(idx));
+}
+
+inline std::optional<Extern> Caller::get_export(std::string_view name) {
+  wasmtime_extern_t item;
+  if (wasmtime_caller_export_get(ptr, name.data(), name.size(), &item)) {
+    return Instance::cvt(item);
+  }
+  return std::nullopt;
+}
+
+#ifdef WASMTIME_FEATURE_ASYNC
+namespace detail {
+
+/// Conversion of native host values to and from `Val`, used by the async
+/// typed APIs since the async C API only traffics in `wasmtime_val_t`.
+template <typename T> Val to_val(const T &t) {
+  if constexpr (WasmType<T>::kind == ValKind::I32) {
+    return Val(static_cast<int32_t>(t));
+  } else if constexpr (WasmType<T>::kind == ValKind::I64) {
+    return Val(static_cast<int64_t>(t));
+  } else {
+    return Val(t);
+  }
+}
+
+/// Inverse of `to_val`, the type of `val` must already have been checked.
+template <typename T> T from_val(Store::Context cx, const Val &val) {
+  constexpr ValKind kind = WasmType<T>::kind;
+  if constexpr (kind == ValKind::I32) {
+    return static_cast<T>(val.i32());
+  } else if constexpr (kind == ValKind::I64) {
+    return static_cast<T>(val.i64());
+  } else if constexpr (kind == ValKind::F32) {
+    return val.f32();
+  } else if constexpr (kind == ValKind::F64) {
+    return val.f64();
+  } else if constexpr (kind == ValKind::V128) {
+    return val.v128();
+  } else if constexpr (kind == ValKind::FuncRef) {
+    return val.funcref();
+  } else {
+    return val.externref(cx);
+  }
+}
+
+/// `WasmTypeList` counterpart of `to_val` and `from_val`.
+template <typename T> struct ValList {
+  static void store(const T &t, Span<Val> vals) { vals[0] = to_val(t); }
+  static T load(Store::Context cx, Span<const Val> vals) {
+    return from_val<T>(cx, vals[0]);
+  }
+};
+
+template <> struct ValList<std::monostate> {
+  static void store(const std::monostate & /*t*/, Span<Val> /*vals*/) {}
+  static std::monostate load(Store::Context /*cx*/, Span<const Val> /*vals*/) {
+    return std::monostate();
+  }
+};
+
+template <typename... T> struct ValList<std::tuple<T...>> {
+  static void store(const std::tuple<T...> &t, Span<Val> vals) {
+    size_t n = 0;
+    std::apply([&](const auto &...val) { ((vals[n++] = to_val(val)), ...); },
+               t);
+  }
+  static std::tuple<T...> load(Store::Context cx, Span<const Val> vals) {
+    size_t n = 0;
+    return std::tuple<T...>{from_val<T>(cx, vals[n++])...}; // NOLINT
+  }
+};
+
+/// Counts completions of async host functions whose calls aren't being
+/// awaited, so that a `Scheduler` whose calls are all blocked on them can
+/// sleep until one may make progress.
+struct AsyncWakeups {
+  std::mutex lock;
+  std::condition_variable cv;
+  std::atomic<uint64_t> count{0};
+
+  static AsyncWakeups &global() {
+    static AsyncWakeups wakeups;
+    return wakeups;
+  }
+
+  void notify() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      count.fetch_add(1, std::memory_order_release);
+    }
+    cv.notify_all();
+  }
+
+  /// Blocks until `count` differs from `seen`.
+  void wait(uint64_t seen) {
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard,
+            [&] { return count.load(std::memory_order_acquire) != seen; });
+  }
+};
+
+/// State of an in-progress asynchronous call.
+///
+/// The C API writes the outcome of a call through pointers into this state, so
+/// it lives on the heap at a stable address. It's reference counted because
+/// pending async host functions may need to wake it up from another thread.
+struct AsyncCallState : std::enable_shared_from_this<AsyncCallState> {
+  wasmtime_call_future_t *future = nullptr;
+  wasm_trap_t *trap = nullptr;
+  wasmtime_error_t *error = nullptr;
+  wasmtime_context_t *cx = nullptr;
+  std::vector<Val> params;
+  std::vector<Val> results;
+  wasmtime_instance_t instance{};
+  bool done = false;
+  // Set if the last `poll` stopped because an async host function hadn't
+  // completed yet, rather than because the call yielded.
+  bool blocked = false;
+
+#ifdef WASMTIME_CPP_COROUTINES
+  std::mutex lock;
+  bool woken = false;
+  std::coroutine_handle<> waiter;
+#endif
+
+  AsyncCallState() = default;
+  AsyncCallState(const AsyncCallState &) = delete;
+  AsyncCallState &operator=(const AsyncCallState &) = delete;
+
+  ~AsyncCallState() {
+    if (future != nullptr) {
+      wasmtime_call_future_delete(future);
+    }
+    if (trap != nullptr) {
+      wasm_trap_delete(trap);
+    }
+    if (error != nullptr) {
+      wasmtime_error_delete(error);
+    }
+  }
+
+  /// The call currently being polled on this thread, if any, which is how
+  /// async host functions find the call to wake once they complete.
+  static AsyncCallState *&current() {
+    static thread_local AsyncCallState *current = nullptr;
+    return current;
+  }
+
+  bool poll() {
+    if (!done) {
+      blocked = false;
+      AsyncCallState *prev = std::exchange(current(), this);
+      done = future == nullptr || wasmtime_call_future_poll(future);
+      current() = prev;
+    }
+    return done;
+  }
+
+#ifdef WASMTIME_CPP_COROUTINES
+  // Suspends `h` until the call can make progress, re-polling whenever a host
+  // function woke the call in the meantime. Returns `false` if the call
+  // finished and `h` should continue immediately.
+  bool park(std::coroutine_handle<> h) {
+    while (true) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!woken) {
+          waiter = h;
+          return true;
+        }
+        woken = false;
+      }
+      if (poll()) {
+        return false;
+      }
+    }
+  }
+
+  // Called when an async host function this call is blocked on completes,
+  // possibly from another thread.
+  void wake() {
+    std::coroutine_handle<> h;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      if (!waiter) {
+        woken = true;
+        guard.unlock();
+        // Nobody is awaiting the call, so it may be driven by a `Scheduler`.
+        AsyncWakeups::global().notify();
+        return;
+      }
+      h = std::exchange(waiter, nullptr);
+    }
+    if (poll() || !park(h)) {
+      h.resume();
+    }
+  }
+#endif // WASMTIME_CPP_COROUTINES
+
+  /// Returns whether an async host function this call was blocked on has
+  /// completed since this was last called.
+  bool take_wakeup() {
+#ifdef WASMTIME_CPP_COROUTINES
+    std::lock_guard<std::mutex> guard(lock);
+    return std::exchange(woken, false);
+#else
+    return true;
+#endif
+  }
+};
+
+} // namespace detail
+
+/**
+ * \brief An asynchronous WebAssembly call which is in progress.
+ *
+ * Returned by `Func::call_async`, `TypedFunc::call_async`, and
+ * `Linker::instantiate_async`, which require `Config::async_support`. Nothing
+ * runs until the future is polled: each call to `poll` runs WebAssembly until
+ * it either finishes or is blocked on an async host function (or yields due to
+ * `Store::Context::fuel_async_yield_interval` and friends). Once `poll`
+ * returns `true` the outcome is available through `get`.
+ *
+ * With C++20 coroutines (see `WASMTIME_CPP_COROUTINES`) a `CallFuture` can
+ * also be `co_await`ed, producing the result of `get`. An awaiting coroutine
+ * is resumed on whichever thread completes the async host function it was
+ * blocked on, so many calls can be multiplexed onto a few threads.
+ *
+ * The store that the call was started in must not be used for anything else
+ * until the call finishes, and the future must not be destroyed while an
+ * async host function it called is still pending.
+ */
+template <typename T> class CallFuture {
+  friend class Func;
+  friend class Linker;
+  friend class Scheduler;
+  template <typename Params, typename Results> friend class TypedFunc;
+
+  std::shared_ptr<detail::AsyncCallState> state;
+  TrapResult<T> (*finish)(detail::AsyncCallState &);
+
+  CallFuture(std::shared_ptr<detail::AsyncCallState> state,
+             TrapResult<T> (*finish)(detail::AsyncCallState &))
+      : state(std::move(state)), finish(finish) {}
+
+public:
+  CallFuture(const CallFuture &) = delete;
+  CallFuture &operator=(const CallFuture &) = delete;
+  /// Moves an in-progress call into a new future.
+  CallFuture(CallFuture &&other) = default;
+  /// Moves an in-progress call into this future.
+  CallFuture &operator=(CallFuture &&other) = default;
+
+  /// Runs the call until it finishes or blocks, returning whether it has
+  /// finished.
+  bool poll() { return state->poll(); }
+
+  /// \brief Returns the outcome of the call, which must have finished.
+  ///
+  /// This can only be called once.
+  TrapResult<T> get() {
+    if (state->error != nullptr) {
+      return TrapError(Error(std::exchange(state->error, nullptr)));
+    }
+    if (state->trap != nullptr) {
+      return TrapError(Trap(std::exchange(state->trap, nullptr)));
+    }
+    return finish(*state);
+  }
+
+#ifdef WASMTIME_CPP_COROUTINES
+  /// \brief Polls the call once, part of the awaitable interface.
+  bool await_ready() { return poll(); }
+  /// \brief Suspends the awaiting coroutine until the call finishes, part of
+  /// the awaitable interface.
+  bool await_suspend(std::coroutine_handle<> h) { return state->park(h); }
+  /// \brief Returns `get()`, part of the awaitable interface.
+  TrapResult<T> await_resume() { return get(); }
+#endif
+};
+
+inline CallFuture<std::vector<Val>>
+Func::call_async(Store::Context cx, std::vector<Val> params) const {
+  auto state = std::make_shared<detail::AsyncCallState>();
+  state->cx = cx.ptr;
+  state->params = std::move(params);
+  state->results.resize(this->result_count(cx));
+  state->future = wasmtime_func_call_async(
+      cx.ptr, &func,
+      reinterpret_cast<const wasmtime_val_t *>(state->params.data()), // NOLINT
+      state->params.size(),
+      reinterpret_cast<wasmtime_val_t *>(state->results.data()), // NOLINT
+      state->results.size(), &state->trap, &state->error);
+  return CallFuture<std::vector<Val>>(
+      std::move(state),
+      [](detail::AsyncCallState &s) -> TrapResult<std::vector<Val>> {
+        return std::move(s.results);
+      });
+}
+
+template <typename Params, typename Results>
+inline CallFuture<Results>
+TypedFunc<Params, Results>::call_async(Store::Context cx,
+                                       const Params &params) const {
+  std::vector<Val> vals(WasmTypeList<Params>::size);
+  detail::ValList<Params>::store(params, vals);
+  auto future = f.call_async(cx, std::move(vals));
+  return CallFuture<Results>(
+      std::move(future.state),
+      [](detail::AsyncCallState &s) -> TrapResult<Results> {
+        return detail::ValList<Results>::load(s.cx, s.results);
+      });
+}
+
+/**
+ * \brief Cooperative time-slicing of asynchronous calls across many stores.
+ *
+ * A `Scheduler` owns a ticker thread which increments its engine's epoch
+ * every `tick`, and runs `CallFuture`s round-robin on the thread calling
+ * `run`. Every call belongs to a tenant whose time slice is a number of epoch
+ * ticks (and optionally an amount of fuel): stores are configured to yield
+ * back to the scheduler, rather than trap, once their slice is used up, after
+ * which the next tenant gets a turn. Tenants take turns regardless of how
+ * many calls they have queued, so a noisy tenant can't starve the others.
+ *
+ * The engine must be configured with `Config::async_support` and
+ * `Config::epoch_interruption` (plus `Config::consume_fuel` if fuel slices
+ * are used) and must outlive the scheduler.
+ *
+ * Per-tenant CPU time, slice lengths, and completion latencies are available
+ * from `stats`, and `fairness` summarizes how evenly CPU time has been shared.
+ *
+ * Apart from the internal ticker thread, a `Scheduler` isn't thread-safe.
+ * A call blocked on an async host function isn't polled again until that
+ * function completes, and `run` sleeps while every pending call is blocked.
+ */
+class Scheduler {
+public:
+  /// Identifier of a tenant returned by `add_tenant`.
+  using TenantId = size_t;
+
+  /// \brief Statistics about one tenant.
+  struct TenantStats {
+    /// Name given to `add_tenant`.
+    std::string name;
+    /// Calls spawned but not yet finished.
+    size_t pending = 0;
+    /// Calls which have finished.
+    uint64_t completed = 0;
+    /// Number of turns this tenant has been given.
+    uint64_t slices = 0;
+    /// Total time spent running this tenant's calls.
+    std::chrono::nanoseconds cpu_time{0};
+    /// Longest single turn, which exceeds the slice if guests don't yield.
+    std::chrono::nanoseconds max_slice{0};
+    /// Median time from `spawn` to completion over recent calls.
+    std::chrono::nanoseconds p50_latency{0};
+    /// 99th percentile time from `spawn` to completion over recent calls.
+    std::chrono::nanoseconds p99_latency{0};
+    /// Longest time from `spawn` to completion over recent calls.
+    std::chrono::nanoseconds max_latency{0};
+  };
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  // Number of recent completion latencies kept per tenant for percentiles.
+  static constexpr size_t latency_window = 1024;
+
+  struct Task {
+    Store::Context cx;
+    Clock::time_point spawned;
+    std::shared_ptr<detail::AsyncCallState> call;
+    // Polls the call, delivering its result and returning `true` once done.
+    std::function<bool()> step;
+    // Whether the last poll stopped on an async host function, in which case
+    // polling again is pointless until that function completes.
+    bool blocked = false;
+
+    bool runnable() { return !blocked || call->take_wakeup(); }
+  };
+
+  struct Tenant {
+    std::string name;
+    uint64_t slice_ticks;
+    std::optional<uint64_t> slice_fuel;
+    std::list<Task> tasks;
+    uint64_t completed = 0;
+    uint64_t slices = 0;
+    std::chrono::nanoseconds cpu_time{0};
+    std::chrono::nanoseconds max_slice{0};
+    std::vector<std::chrono::nanoseconds> latencies;
+    size_t next_latency = 0;
+  };
+
+  Engine *engine;
+  std::vector<Tenant> tenants;
+  size_t next_tenant = 0;
+  std::atomic<bool> stop{false};
+  std::thread ticker;
+
+  void record_latency(Tenant &tenant, std::chrono::nanoseconds latency) {
+    if (tenant.latencies.size() < latency_window) {
+      tenant.latencies.push_back(latency);
+    } else {
+      tenant.latencies[tenant.next_latency] = latency;
+      tenant.next_latency = (tenant.next_latency + 1) % latency_window;
+    }
+  }
+
+  // Gives `tenant` one turn, resuming its oldest runnable call for one
+  // slice. Returns `false` if all of its calls are blocked.
+  bool turn(Tenant &tenant) {
+    auto it = tenant.tasks.begin();
+    while (it != tenant.tasks.end() && !it->runnable()) {
+      ++it;
+    }
+    if (it == tenant.tasks.end()) {
+      return false;
+    }
+    Task &task = *it;
+    task.cx.set_epoch_deadline(tenant.slice_ticks);
+    auto start = Clock::now();
+    bool done = task.step();
+    auto end = Clock::now();
+    task.blocked = !done && task.call->blocked;
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end - start);
+    tenant.slices++;
+    tenant.cpu_time += elapsed;
+    tenant.max_slice = std::max(tenant.max_slice, elapsed);
+    if (done) {
+      tenant.completed++;
+      record_latency(tenant,
+                     std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         end - task.spawned));
+      tenant.tasks.erase(it);
+    } else {
+      tenant.tasks.splice(tenant.tasks.end(), tenant.tasks, it);
+    }
+    return true;
+  }
+
+public:
+  /// Creates a scheduler for calls in stores of `engine`, incrementing the
+  /// engine's epoch every `tick`.
+  Scheduler(Engine &engine, std::chrono::microseconds tick)
+      : engine(&engine), ticker([this, tick] {
+          while (!stop.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(tick);
+            this->engine->increment_epoch();
+          }
+        }) {}
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  ~Scheduler() {
+    stop.store(true, std::memory_order_relaxed);
+    ticker.join();
+  }
+
+  /// \brief Adds a tenant whose calls run for `slice_ticks` epoch ticks per
+  /// turn.
+  ///
+  /// If `slice_fuel` is given the tenant's calls also yield every
+  /// `slice_fuel` units of fuel, which gives deterministic slices.
+  TenantId add_tenant(std::string name, uint64_t slice_ticks,
+                      std::optional<uint64_t> slice_fuel = std::nullopt) {
+    Tenant tenant;
+    tenant.name = std::move(name);
+    tenant.slice_ticks = std::max<uint64_t>(slice_ticks, 1);
+    tenant.slice_fuel = slice_fuel;
+    tenants.push_back(std::move(tenant));
+    return tenants.size() - 1;
+  }
+
+  /// \brief Schedules `future`, a call running in the store `cx`, on behalf
+  /// of `tenant`, invoking `done` with its outcome once it finishes.
+  ///
+  /// The store is configured to yield at the end of each slice. Fails if
+  /// that configuration fails, for example because the engine doesn't have
+  /// epoch interruption enabled.
+  template <typename T, typename F>
+  Result<std::monostate> spawn(TenantId tenant, Store::Context cx,
+                               CallFuture<T> future, F done) {
+    Tenant &t = tenants.at(tenant);
+    auto result = cx.epoch_deadline_async_yield_and_update(t.slice_ticks);
+    if (!result) {
+      return result;
+    }
+    if (t.slice_fuel) {
+      result = cx.fuel_async_yield_interval(*t.slice_fuel);
+      if (!result) {
+        return result;
+      }
+    }
+    auto state = future.state;
+    auto call = std::make_shared<CallFuture<T>>(std::move(future));
+    t.tasks.push_back(Task{cx, Clock::now(), std::move(state),
+                           [call, done]() mutable {
+                             if (!call->poll()) {
+                               return false;
+                             }
+                             done(call->get());
+                             return true;
+                           }});
+    return std::monostate();
+  }
+
+  /// Returns the number of calls which haven't finished yet.
+  size_t pending() const {
+    size_t n = 0;
+    for (const auto &tenant : tenants) {
+      n += tenant.tasks.size();
+    }
+    return n;
+  }
+
+  /// \brief Gives the next tenant with a runnable call a turn, returning
+  /// `false` if there was nothing to run.
+  ///
+  /// Nothing can run if no calls are pending or if every pending call is
+  /// still blocked on an async host function.
+  bool run_once() {
+    for (size_t i = 0; i < tenants.size(); i++) {
+      Tenant &tenant = tenants[next_tenant];
+      next_tenant = (next_tenant + 1) % tenants.size();
+      if (turn(tenant)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Runs calls until all of them have finished, sleeping whenever every
+  /// pending call is blocked on an async host function.
+  void run() {
+    auto &wakeups = detail::AsyncWakeups::global();
+    while (pending() > 0) {
+      uint64_t seen = wakeups.count.load(std::memory_order_acquire);
+      if (!run_once()) {
+        wakeups.wait(seen);
+      }
+    }
+  }
+
+  /// Returns statistics about every tenant, indexed by `TenantId`.
+  std::vector<TenantStats> stats() const {
+    std::vector<TenantStats> ret;
+    for (const auto &tenant : tenants) {
+      TenantStats s;
+      s.name = tenant.name;
+      s.pending = tenant.tasks.size();
+      s.completed = tenant.completed;
+      s.slices = tenant.slices;
+      s.cpu_time = tenant.cpu_time;
+      s.max_slice = tenant.max_slice;
+      auto latencies = tenant.latencies;
+      if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        s.p50_latency = latencies[latencies.size() / 2];
+        s.p99_latency = latencies[latencies.size() * 99 / 100];
+        s.max_latency = latencies.back();
+      }
+      ret.push_back(std::move(s));
+    }
+    return ret;
+  }
+
+  /// \brief Returns Jain's fairness index of the CPU time given to each tenant
+  /// that has run, relative to its slice length.
+  ///
+  /// This is 1.0 when every tenant got a share proportional to its slice and
+  /// approaches `1 / n` when a single tenant out of `n` got everything.
+  double fairness() const {
+    double sum = 0;
+    double sum_squares = 0;
+    size_t n = 0;
+    for (const auto &tenant : tenants) {
+      if (tenant.slices == 0) {
+        continue;
+      }
+      double share = double(tenant.cpu_time.count()) / tenant.slice_ticks;
+      sum += share;
+      sum_squares += share * share;
+      n++;
+    }
+    if (n == 0 || sum_squares == 0) {
+      return 1.0;
+    }
+    return sum * sum / (double(n) * sum_squares);
+  }
+};
+#endif // WASMTIME_FEATURE_ASYNC
+
+#ifdef WASMTIME_CPP_COROUTINES
+namespace detail {
+
+/// Coroutine driving an async host function to completion on behalf of the
+/// `CallFuture` which called it.
+struct AsyncHostTask {
+  struct promise_type {
+    std::optional<Result<std::monostate, Trap>> result;
+    std::atomic<bool> finished{false};
+    std::shared_ptr<AsyncCallState> call;
+
+    AsyncHostTask get_return_object() {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    void return_value(Result<std::monostate, Trap> ret) {
+      result.emplace(std::move(ret));
+    }
+    void unhandled_exception() { std::abort(); }
+
+    auto final_suspend() noexcept {
+      struct Finish {
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // Once `finished` is set this task may be destroyed by whoever polls
+          // the call next, so the frame must not be touched afterwards.
+          auto call = std::move(h.promise().call);
+          h.promise().finished.store(true, std::memory_order_release);
+          if (call) {
+            call->wake();
+          }
+        }
+        void await_resume() noexcept {}
+      };
+      return Finish{};
+    }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/// Adapts any awaitable producing `Result<std::monostate, Trap>` to an
+/// `AsyncHostTask`.
+template <typename A> AsyncHostTask await_host(A awaitable) {
+  co_return co_await std::move(awaitable);
+}
+
+/// Signature information for callables given to `Linker::func_wrap_async`,
+/// which return an awaitable rather than a value.
+template <typename F, typename = void> struct AsyncHostFunc;
+
+template <typename R, typename... A> struct AsyncHostFunc<R (*)(A...)> {
+  using Params = std::tuple<A...>;
+  using Output = decltype(std::declval<R &>().await_resume());
+
+  template <typename F>
+  static R invoke(F &f, Caller /*cx*/, const A &...args) {
+    return f(args...);
+  }
+};
+
+template <typename R, typename... A>
+struct AsyncHostFunc<R (*)(Caller, A...)> : public AsyncHostFunc<R (*)(A...)> {
+  template <typename F> static R invoke(F &f, Caller cx, const A &...args) {
+    return f(cx, args...);
+  }
+};
+
+template <typename R, typename C, typename... A>
+struct AsyncHostFunc<R (C::*)(A...)> : public AsyncHostFunc<R (*)(A...)> {};
+
+template <typename R, typename C, typename... A>
+struct AsyncHostFunc<R (C::*)(A...) const>
+    : public AsyncHostFunc<R (*)(A...)> {};
+
+template <typename T>
+struct AsyncHostFunc<T, std::void_t<decltype(&T::operator())>>
+    : public AsyncHostFunc<decltype(&T::operator())> {};
+
+/// Stores the output of an async host function into its results, mirroring
+/// what `WasmHostRet` accepts for synchronous host functions.
+template <typename R> struct AsyncHostRet {
+  static Result<std::monostate, Trap> store(R ret, Span<Val> results) {
+    ValList<R>::store(ret, results);
+    return std::monostate();
+  }
+};
+
+template <> struct AsyncHostRet<std::monostate> {
+  static Result<std::monostate, Trap> store(std::monostate /*ret*/,
+                                            Span<Val> /*results*/) {
+    return std::monostate();
+  }
+};
+
+template <typename R> struct AsyncHostRet<Result<R, Trap>> {
+  static Result<std::monostate, Trap> store(Result<R, Trap> ret,
+                                            Span<Val> results) {
+    if (!ret) {
+      return ret.err();
+    }
+    return AsyncHostRet<R>::store(ret.ok(), results);
   }
 };
 
-inline std::optional<Extern> Caller::get_export(std::string_view name) {
-  wasmtime_extern_t item;
-  if (wasmtime_caller_export_get(ptr, name.data(), name.size(), &item)) {
-    return Instance::cvt(item);
+/// Body of the host functions defined by `Linker::func_wrap_async`.
+template <typename F>
+AsyncHostTask await_wrapped(F &f, Caller caller, Span<const Val> args,
+                            Span<Val> results) {
+  using HostFunc = AsyncHostFunc<F>;
+  using Output = typename HostFunc::Output;
+  auto params = ValList<typename HostFunc::Params>::load(caller, args);
+  auto call = [&](const auto &...a) { return HostFunc::invoke(f, caller, a...); };
+  if constexpr (std::is_void_v<Output>) {
+    co_await std::apply(call, params);
+    co_return std::monostate();
+  } else {
+    co_return AsyncHostRet<Output>::store(co_await std::apply(call, params),
+                                          results);
   }
-  return std::nullopt;
 }
 
+} // namespace detail
+#endif // WASMTIME_CPP_COROUTINES
+
+/**
+ * \brief A module whose imports have already been resolved by a `Linker`.
+ *
+ * Created with `Linker::instantiate_pre`, an `InstancePre` performs name
+ * resolution and type-checking of a module's imports once, so that each
+ * subsequent `instantiate` only has to create the instance itself. This is
+ * intended for hot paths which instantiate the same module many times, such as
+ * once per request in a fresh `Store`.
+ *
+ * The imports resolved by the linker must not be tied to a particular store
+ * (for example host functions defined with `Linker::func_new` or
+ * `Linker::func_wrap`), since each instantiation may happen in a different
+ * store.
+ *
+ * An `InstancePre` is safe to share between threads: `instantiate` may be
+ * called concurrently from multiple threads, each with its own store.
+ */
+class InstancePre {
+  friend class Linker;
+
+  struct deleter {
+    void operator()(wasmtime_instance_pre_t *p) const {
+      wasmtime_instance_pre_delete(p);
+    }
+  };
+
+  std::unique_ptr<wasmtime_instance_pre_t, deleter> ptr;
+
+  InstancePre(wasmtime_instance_pre_t *raw) : ptr(raw) {}
+
+public:
+  /// \brief Instantiates the pre-resolved module within the store `cx`.
+  ///
+  /// This can fail if the module's start function traps or if resources for
+  /// the instance can't be allocated.
+  TrapResult<Instance> instantiate(Store::Context cx) const {
+    wasmtime_instance_t instance;
+    wasm_trap_t *trap = nullptr;
+    auto *error =
+        wasmtime_instance_pre_instantiate(ptr.get(), cx.ptr, &instance, &trap);
+    if (error != nullptr) {
+      return TrapError(Error(error));
+    }
+    if (trap != nullptr) {
+      return TrapError(Trap(trap));
+    }
+    return Instance(instance);
+  }
+
+  /// \brief Returns the module that this will instantiate.
+  Module module() const { return wasmtime_instance_pre_module(ptr.get()); }
+};
+
+/**
+ * \brief A thread-safe pool of reusable `Store`s.
+ *
+ * Creating a `Store` per request is relatively expensive, so a `StorePool`
+ * keeps a bounded number of idle stores around and hands them out with fuel,
+ * epoch deadline, and limiter settings already applied. Stores are checked
+ * out with `checkout`, which returns a `Lease` that gives the store back to
+ * the pool when destroyed.
+ *
+ * Wasmtime has no way to reset a store, so everything created within a store
+ * (instances, memories, host data) stays alive until the store itself is
+ * destroyed. To bound that growth each store is only reused `max_uses` times
+ * before it's dropped and replaced by a fresh one. The store's user data is
+ * cleared every time it's returned to the pool.
+ *
+ * Store limits configured with `limiter` are cumulative over a store's
+ * lifetime, so a store is also dropped before a checkout whose instantiation
+ * would exceed its `instances` limit. Other limits (memories, tables, memory
+ * size, or pooling allocator slots) can't be predicted, so if preparing a
+ * reused store fails it's dropped and the checkout is retried once with a
+ * fresh store.
+ *
+ * If an `InstancePre` is configured with `instantiate` then every lease comes
+ * with a freshly created instance of it, so requests never observe each
+ * other's linear memory or globals. Wasmtime's C API can't reset an existing
+ * instance, so this fresh instantiation is how a lease gets a pristine heap:
+ * with `Config::memory_init_cow` enabled its memories are mapped from the
+ * module's copy-on-write image rather than having their data segments
+ * copied in, and with the pooling allocator their slots are reused and only
+ * the pages dirtied by earlier requests are reset.
+ *
+ * Idle stores are kept in several independently locked free lists and each
+ * thread returns stores to the list its id hashes to, so concurrent workers
+ * rarely contend on the same lock. A checkout which finds its own list empty
+ * takes a store from the other lists before creating a new one, so a store
+ * released on one thread can be reused on any other. The `max_idle` bound
+ * applies to the pool as a whole rather than to each list.
+ *
+ * All configuration methods must be called before the first `checkout`;
+ * `checkout` and `stats` may then be called concurrently from any thread.
+ */
+class StorePool {
+public:
+  /// \brief Counters describing the pool's behavior so far.
+  struct Stats {
+    /// Number of successful calls to `checkout`, always `hits + misses`.
+    uint64_t checkouts = 0;
+    /// Successful checkouts which reused an idle store.
+    uint64_t hits = 0;
+    /// Successful checkouts which had to create a new store.
+    uint64_t misses = 0;
+    /// Calls to `checkout` which returned an error.
+    uint64_t failures = 0;
+    /// Stores dropped because they reached `max_uses` or their limits, or
+    /// because the pool was full.
+    uint64_t retired = 0;
+    /// Stores currently idle in the pool, never more than `max_idle`.
+    size_t idle = 0;
+    /// Total time spent inside `checkout`, including instantiation.
+    std::chrono::nanoseconds checkout_time{0};
+
+    /// Fraction of checkouts which reused an idle store.
+    double hit_rate() const {
+      return checkouts == 0 ? 0.0 : double(hits) / double(checkouts);
+    }
+
+    /// Average time spent inside `checkout`.
+    std::chrono::nanoseconds mean_checkout_time() const {
+      return checkouts == 0 ? std::chrono::nanoseconds(0)
+                            : checkout_time / int64_t(checkouts);
+    }
+  };
+
+private:
+  struct Slot {
+    Store store;
+    size_t uses = 0;
+    // Number of instances created in `store` so far.
+    int64_t instances = 0;
+
+    explicit Slot(Engine &engine) : store(engine) {}
+  };
+
+  struct Shard {
+    std::mutex lock;
+    std::vector<std::unique_ptr<Slot>> idle;
+  };
+
+  struct Limits {
+    int64_t memory_size, table_elements, instances, tables, memories;
+  };
+
+  Engine *engine;
+  size_t max_idle;
+  size_t max_uses_ = 100;
+  std::optional<uint64_t> fuel_;
+  std::optional<uint64_t> epoch_deadline_;
+  std::optional<Limits> limits;
+  std::optional<InstancePre> pre;
+
+  size_t nshards;
+  std::unique_ptr<Shard[]> shards;
+
+  std::atomic<uint64_t> checkouts{0};
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  std::atomic<uint64_t> failures{0};
+  std::atomic<uint64_t> retired{0};
+  // Number of idle stores across all shards, including ones about to be
+  // pushed, so that it never exceeds `max_idle`.
+  std::atomic<size_t> idle{0};
+  std::atomic<uint64_t> checkout_ns{0};
+
+  size_t local_shard() const {
+    size_t h = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return h % nshards;
+  }
+
+  std::unique_ptr<Slot> create() {
+    auto slot = std::make_unique<Slot>(*engine);
+    if (limits) {
+      slot->store.limiter(limits->memory_size, limits->table_elements,
+                          limits->instances, limits->tables, limits->memories);
+    }
+    return slot;
+  }
+
+  // Returns an idle store, setting `hit`, or a new one.
+  std::unique_ptr<Slot> acquire(bool &hit) {
+    size_t local = local_shard();
+    // Start with this thread's own shard, then steal from its neighbours.
+    for (size_t i = 0; i < nshards && idle.load(std::memory_order_relaxed) > 0;
+         i++) {
+      Shard &shard = shards[(local + i) % nshards];
+      std::lock_guard<std::mutex> guard(shard.lock);
+      if (!shard.idle.empty()) {
+        auto slot = std::move(shard.idle.back());
+        shard.idle.pop_back();
+        idle.fetch_sub(1, std::memory_order_relaxed);
+        hit = true;
+        return slot;
+      }
+    }
+    hit = false;
+    return create();
+  }
+
+  // Whether preparing `slot` again stays within its store's instance limit.
+  bool has_room(const Slot &slot) const {
+    if (!pre || !limits || limits->instances < 0) {
+      return true;
+    }
+    return slot.instances < limits->instances;
+  }
+
+  void release(std::unique_ptr<Slot> slot) {
+    if (slot->uses < max_uses_) {
+      auto cx = slot->store.context();
+      if (wasmtime_context_get_data(cx.raw_context()) != nullptr) {
+        cx.get_data().reset();
+      }
+      if (idle.fetch_add(1, std::memory_order_relaxed) < max_idle) {
+        Shard &shard = shards[local_shard()];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.idle.push_back(std::move(slot));
+        return;
+      }
+      idle.fetch_sub(1, std::memory_order_relaxed);
+    }
+    retired.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  TrapResult<std::monostate> prepare(Slot &slot,
+                                     std::optional<Instance> &instance) {
+    auto cx = slot.store.context();
+    if (fuel_) {
+      auto result = cx.set_fuel(*fuel_);
+      if (!result) {
+        return TrapError(result.err());
+      }
+    }
+    if (epoch_deadline_) {
+      cx.set_epoch_deadline(*epoch_deadline_);
+    }
+    if (pre) {
+      auto result = pre->instantiate(cx);
+      slot.instances++;
+      if (!result) {
+        return result.err();
+      }
+      instance = result.ok();
+    }
+    return std::monostate();
+  }
+
+public:
+  /**
+   * \brief A `Store` checked out of a `StorePool`.
+   *
+   * The store is returned to the pool when the lease is destroyed. A lease
+   * must not outlive the pool it came from.
+   */
+  class Lease {
+    friend class StorePool;
+
+    StorePool *pool;
+    std::unique_ptr<Slot> slot;
+    std::optional<Instance> instance_;
+
+    Lease(StorePool *pool, std::unique_ptr<Slot> slot,
+          std::optional<Instance> instance)
+        : pool(pool), slot(std::move(slot)), instance_(instance) {}
+
+  public:
+    /// Moves a lease, leaving `other` empty.
+    Lease(Lease &&other) = default;
+    /// Moves a lease, returning the currently held store to its pool first.
+    Lease &operator=(Lease &&other) {
+      if (this != &other) {
+        reset();
+        pool = other.pool;
+        slot = std::move(other.slot);
+        instance_ = other.instance_;
+      }
+      return *this;
+    }
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+
+    ~Lease() { reset(); }
+
+    /// Returns the store early, leaving this lease empty.
+    void reset() {
+      if (slot) {
+        pool->release(std::move(slot));
+      }
+      instance_ = std::nullopt;
+    }
+
+    /// Returns the leased store.
+    Store &store() { return slot->store; }
+
+    /// Returns a context for the leased store.
+    Store::Context context() { return slot->store; }
+
+    /// Returns the instance created from the pool's `InstancePre`, if one was
+    /// configured.
+    const std::optional<Instance> &instance() const { return instance_; }
+  };
+
+  /// \brief Creates a pool of stores for `engine` keeping at most `max_idle`
+  /// idle stores around.
+  ///
+  /// The `engine` must outlive the pool.
+  StorePool(Engine &engine, size_t max_idle)
+      : engine(&engine), max_idle(max_idle),
+        nshards(std::max<size_t>(
+            1, std::min<size_t>(max_idle, std::thread::hardware_concurrency()))),
+        shards(std::make_unique<Shard[]>(nshards)) {}
+
+  StorePool(const StorePool &) = delete;
+  StorePool &operator=(const StorePool &) = delete;
+
+  /// Configures how many times a store may be checked out before it's
+  /// dropped rather than returned to the pool. Defaults to 100.
+  ///
+  /// With `instantiate` every checkout adds an instance, with its memories
+  /// and tables, to the store, so this also bounds how much a store
+  /// accumulates. A store is dropped earlier if it reaches the `instances`
+  /// limit given to `limiter`.
+  void max_uses(size_t uses) { max_uses_ = uses; }
+
+  /// Configures the fuel every checked out store starts with.
+  ///
+  /// Requires `Config::consume_fuel`.
+  void fuel(uint64_t fuel) { fuel_ = fuel; }
+
+  /// Configures the epoch deadline, relative to the engine's current epoch,
+  /// applied to every checked out store.
+  void epoch_deadline(uint64_t ticks_beyond_current) {
+    epoch_deadline_ = ticks_beyond_current;
+  }
+
+  /// Configures the limits applied to every store in this pool, with the same
+  /// meaning as the arguments to `Store::limiter`.
+  ///
+  /// These limits cover everything created over a store's lifetime, not just
+  /// a single lease; see the class documentation for how the pool keeps
+  /// reused stores within them.
+  void limiter(int64_t memory_size, int64_t table_elements, int64_t instances,
+               int64_t tables, int64_t memories) {
+    limits = Limits{memory_size, table_elements, instances, tables, memories};
+  }
+
+  /// Configures every lease to come with a new instance created from `pre`.
+  void instantiate(InstancePre pre) { this->pre = std::move(pre); }
+
+  /// \brief Checks out a store, creating a new one if no idle store is
+  /// available.
+  ///
+  /// Fails if fuel can't be set on the store or if instantiating the
+  /// configured `InstancePre` fails, even in a fresh store; the store is
+  /// returned to the pool in that case.
+  TrapResult<Lease> checkout() {
+    auto start = std::chrono::steady_clock::now();
+    bool hit = false;
+    auto slot = acquire(hit);
+    if (!has_room(*slot)) {
+      retired.fetch_add(1, std::memory_order_relaxed);
+      slot = create();
+      hit = false;
+    }
+    slot->uses++;
+    std::optional<Instance> instance;
+    auto prepared = prepare(*slot, instance);
+    if (!prepared && slot->uses > 1) {
+      // The reused store may have run into one of its cumulative limits.
+      retired.fetch_add(1, std::memory_order_relaxed);
+      slot = create();
+      hit = false;
+      slot->uses++;
+      instance = std::nullopt;
+      prepared = prepare(*slot, instance);
+    }
+    if (!prepared) {
+      failures.fetch_add(1, std::memory_order_relaxed);
+      release(std::move(slot));
+      return prepared.err();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    (hit ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+    checkouts.fetch_add(1, std::memory_order_relaxed);
+    checkout_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+        std::memory_order_relaxed);
+    return Lease(this, std::move(slot), instance);
+  }
+
+  /// Returns the counters collected so far.
+  Stats stats() const {
+    Stats stats;
+    stats.checkouts = checkouts.load(std::memory_order_relaxed);
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.failures = failures.load(std::memory_order_relaxed);
+    stats.retired = retired.load(std::memory_order_relaxed);
+    stats.idle = idle.load(std::memory_order_relaxed);
+    stats.checkout_time =
+        std::chrono::nanoseconds(checkout_ns.load(std::memory_order_relaxed));
+    return stats;
+  }
+};
+
+#ifdef WASMTIME_CPP_HOST_PROFILING
+/// \brief Statistics about calls into one host function defined with
+/// `Linker::func_new` or `Linker::func_wrap`.
+struct HostCallStats {
+  /// Number of latency histogram buckets.
+  static constexpr size_t buckets = 32;
+
+  /// Module name the function was defined under.
+  std::string module;
+  /// Name the function was defined under.
+  std::string name;
+  /// Number of calls made.
+  uint64_t calls = 0;
+  /// Number of calls which raised a trap.
+  uint64_t traps = 0;
+  /// Total wall time spent in the function.
+  std::chrono::nanoseconds total{0};
+  /// Number of calls by latency: bucket `i` counts calls taking less than
+  /// `2^i` nanoseconds (and at least `2^(i-1)`), with the last bucket also
+  /// counting everything slower.
+  std::array<uint64_t, buckets> histogram{};
+
+  /// Returns the mean latency of a call.
+  std::chrono::nanoseconds mean() const {
+    return calls == 0 ? std::chrono::nanoseconds(0) : total / int64_t(calls);
+  }
+};
+
+namespace detail {
+
+/// Counters for one host function registration, updated on every call.
+struct HostCallCounters {
+  std::string module;
+  std::string name;
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> traps{0};
+  std::atomic<uint64_t> total_ns{0};
+  std::array<std::atomic<uint64_t>, HostCallStats::buckets> histogram{};
+
+  void record(std::chrono::steady_clock::duration elapsed, bool trapped) {
+    auto ns = uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    size_t bucket = 0;
+    while (bucket + 1 < HostCallStats::buckets && (ns >> bucket) != 0) {
+      bucket++;
+    }
+    calls.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+    histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    if (trapped) {
+      traps.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+};
+
+/// Environment of a profiled host function: its counters plus the callable.
+template <typename F> struct ProfiledHostFunc {
+  std::shared_ptr<HostCallCounters> counters;
+  // The callable, as created by `HostEnv<F>::make`.
+  void *env;
+
+  ~ProfiledHostFunc() {
+    if (HostEnv<F>::finalizer != nullptr) {
+      HostEnv<F>::finalizer(env);
+    }
+  }
+};
+
+} // namespace detail
+
+/**
+ * \brief Process-wide record of time spent in host functions.
+ *
+ * This is only available when `WASMTIME_CPP_HOST_PROFILING` is defined before
+ * including this header. In that case every host function defined with
+ * `Linker::func_new` or `Linker::func_wrap` is timed, and its call count,
+ * total and histogrammed latency, and trap count are recorded here under its
+ * module and name. Without the macro no instrumentation is compiled in at all.
+ *
+ * The macro should be set project-wide. It moves the whole API into an
+ * inline namespace, so passing `wasmtime` types between translation units
+ * built with and without it fails to link.
+ *
+ * Registrations of the same module and name, for example the same import
+ * defined in many `Linker`s, share one set of counters, so the number of
+ * entries is bounded by the number of distinct names.
+ *
+ * Counters are updated with relaxed atomics, so recording is cheap and
+ * lock-free, and `snapshot` may be taken from any thread while calls are in
+ * progress. Each call reads `std::chrono::steady_clock` twice.
+ */
+class HostCallProfiler {
+  mutable std::mutex lock;
+  std::vector<std::shared_ptr<detail::HostCallCounters>> registrations;
+  // Position in `registrations` of each module and name, joined by a NUL.
+  std::unordered_map<std::string, size_t> index;
+
+  HostCallProfiler() = default;
+
+public:
+  HostCallProfiler(const HostCallProfiler &) = delete;
+  HostCallProfiler &operator=(const HostCallProfiler &) = delete;
+
+  /// Returns the profiler all host function registrations record into.
+  static HostCallProfiler &global() {
+    static HostCallProfiler profiler;
+    return profiler;
+  }
+
+  /// Returns the counters for host functions named `module`/`name`,
+  /// registering them on first use.
+  std::shared_ptr<detail::HostCallCounters>
+  add(std::string_view module, std::string_view name) {
+    std::string key;
+    key.reserve(module.size() + name.size() + 1);
+    key.append(module).push_back('\0');
+    key.append(name);
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(key);
+    if (it != index.end()) {
+      return registrations[it->second];
+    }
+    auto counters = std::make_shared<detail::HostCallCounters>();
+    counters->module = module;
+    counters->name = name;
+    index.emplace(std::move(key), registrations.size());
+    registrations.push_back(counters);
+    return counters;
+  }
+
+  /// \brief Invokes `f` with the `HostCallStats` of every registration so far,
+  /// in registration order.
+  ///
+  /// Statistics outlive the function they describe, until `clear`.
+  template <typename F> void for_each(F f) const {
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto &counters : registrations) {
+      HostCallStats stats;
+      stats.module = counters->module;
+      stats.name = counters->name;
+      stats.calls = counters->calls.load(std::memory_order_relaxed);
+      stats.traps = counters->traps.load(std::memory_order_relaxed);
+      stats.total = std::chrono::nanoseconds(
+          counters->total_ns.load(std::memory_order_relaxed));
+      for (size_t i = 0; i < HostCallStats::buckets; i++) {
+        stats.histogram[i] =
+            counters->histogram[i].load(std::memory_order_relaxed);
+      }
+      f(stats);
+    }
+  }
+
+  /// Returns the `HostCallStats` of every registration so far.
+  std::vector<HostCallStats> snapshot() const {
+    std::vector<HostCallStats> ret;
+    for_each([&](const HostCallStats &stats) { ret.push_back(stats); });
+    return ret;
+  }
+
+  /// \brief Forgets all registrations.
+  ///
+  /// Functions which are still alive keep recording into counters which are
+  /// no longer reported.
+  void clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    registrations.clear();
+    index.clear();
+  }
+};
+#endif // WASMTIME_CPP_HOST_PROFILING
+
 /**
  * \brief Helper class for linking modules together with name-based resolution.
  *
@@ -3010,6 +7327,106 @@ class Linker {
 
   std::unique_ptr<wasmtime_linker_t, deleter> ptr;
 
+#ifdef WASMTIME_CPP_HOST_PROFILING
+  template <typename F>
+  static wasm_trap_t *raw_profiled_callback(void *env,
+                                            wasmtime_caller_t *caller,
+                                            const wasmtime_val_t *args,
+                                            size_t nargs,
+                                            wasmtime_val_t *results,
+                                            size_t nresults) {
+    auto *profiled = static_cast<detail::ProfiledHostFunc<F> *>(env);
+    auto start = std::chrono::steady_clock::now();
+    auto *trap = Func::raw_callback<F>(profiled->env, caller, args, nargs,
+                                       results, nresults);
+    profiled->counters->record(std::chrono::steady_clock::now() - start,
+                               trap != nullptr);
+    return trap;
+  }
+
+  // Profiles `Callback`, one of `Func`'s unchecked trampolines for `F`.
+  template <typename F, wasmtime_func_unchecked_callback_t Callback>
+  static wasm_trap_t *
+  raw_profiled_callback_unchecked(void *env, wasmtime_caller_t *caller,
+                                  wasmtime_val_raw_t *args_and_results,
+                                  size_t nargs_and_results) {
+    auto *profiled = static_cast<detail::ProfiledHostFunc<F> *>(env);
+    auto start = std::chrono::steady_clock::now();
+    auto *trap =
+        Callback(profiled->env, caller, args_and_results, nargs_and_results);
+    profiled->counters->record(std::chrono::steady_clock::now() - start,
+                               trap != nullptr);
+    return trap;
+  }
+
+  template <typename F>
+  static void *profiled_env(std::string_view module, std::string_view name,
+                            F &&f) {
+    using G = std::remove_reference_t<F>;
+    return new detail::ProfiledHostFunc<G>{
+        HostCallProfiler::global().add(module, name),
+        detail::HostEnv<G>::make(std::forward<F>(f))};
+  }
+#endif // WASMTIME_CPP_HOST_PROFILING
+
+#ifdef WASMTIME_CPP_COROUTINES
+  // An async host function call which is in progress, handed to the C API as
+  // the environment of its continuation.
+  struct AsyncHostCall {
+    detail::AsyncHostTask task;
+    wasm_trap_t **trap_ret;
+
+    ~AsyncHostCall() { task.handle.destroy(); }
+  };
+
+  template <typename F>
+  static void raw_async_callback(void *env, wasmtime_caller_t *caller,
+                                 const wasmtime_val_t *args, size_t nargs,
+                                 wasmtime_val_t *results, size_t nresults,
+                                 wasm_trap_t **trap_ret,
+                                 wasmtime_async_continuation_t *continuation) {
+    F *func = reinterpret_cast<F *>(env);                          // NOLINT
+    Span<const Val> args_span(reinterpret_cast<const Val *>(args), // NOLINT
+                              nargs);
+    Span<Val> results_span(reinterpret_cast<Val *>(results), // NOLINT
+                           nresults);
+    auto awaitable = (*func)(Caller(caller), args_span, results_span);
+    detail::AsyncHostTask task;
+    if constexpr (std::is_same_v<decltype(awaitable), detail::AsyncHostTask>) {
+      task = awaitable;
+    } else {
+      task = detail::await_host(std::move(awaitable));
+    }
+    auto *call = new AsyncHostCall{task, trap_ret};
+    if (auto *current = detail::AsyncCallState::current()) {
+      task.handle.promise().call = current->shared_from_this();
+    }
+    task.handle.resume();
+    continuation->callback = async_continuation;
+    continuation->env = call;
+    continuation->finalizer = async_finalize;
+  }
+
+  static bool async_continuation(void *env) {
+    auto *call = static_cast<AsyncHostCall *>(env);
+    auto &promise = call->task.handle.promise();
+    if (!promise.finished.load(std::memory_order_acquire)) {
+      if (auto *current = detail::AsyncCallState::current()) {
+        current->blocked = true;
+      }
+      return false;
+    }
+    if (!*promise.result) {
+      *call->trap_ret = promise.result->err().ptr.release();
+    }
+    return true;
+  }
+
+  static void async_finalize(void *env) {
+    std::unique_ptr<AsyncHostCall> call(static_cast<AsyncHostCall *>(env));
+  }
+#endif // WASMTIME_CPP_COROUTINES
+
 public:
   /// Creates a new linker which will instantiate in the given engine.
   explicit Linker(Engine &engine)
@@ -3036,6 +7453,22 @@ public:
     return std::monostate();
   }
 
+  /// Defines the shared memory `item` into this linker with the given name.
+  Result<std::monostate> define(Store::Context cx, std::string_view module,
+                                std::string_view name,
+                                const SharedMemory &item) {
+    wasmtime_extern_t raw;
+    raw.kind = WASMTIME_EXTERN_SHAREDMEMORY;
+    raw.of.sharedmemory = item.ptr.get();
+    auto *error =
+        wasmtime_linker_define(ptr.get(), cx.ptr, module.data(), module.size(),
+                               name.data(), name.size(), &raw);
+    if (error != nullptr) {
+      return Error(error);
+    }
+    return std::monostate();
+  }
+
   /// Defines WASI functions within this linker.
   ///
   /// Note that `Store::Context::set_wasi` must also be used for instantiated
@@ -3076,6 +7509,43 @@ public:
     return Instance(instance);
   }
 
+#ifdef WASMTIME_FEATURE_ASYNC
+  /// \brief Asynchronously instantiates the module `m` within the store `cx`
+  /// using the items defined within this linker.
+  ///
+  /// This is required instead of `instantiate` when `Config::async_support`
+  /// is enabled. The module's start function, if any, runs as the returned
+  /// future is polled.
+  CallFuture<Instance> instantiate_async(Store::Context cx,
+                                         const Module &m) const {
+    auto state = std::make_shared<detail::AsyncCallState>();
+    state->cx = cx.ptr;
+    state->future = wasmtime_linker_instantiate_async(
+        ptr.get(), cx.ptr, m.ptr.get(), &state->instance, &state->trap,
+        &state->error);
+    return CallFuture<Instance>(
+        std::move(state), [](detail::AsyncCallState &s) -> TrapResult<Instance> {
+          return Instance(s.instance);
+        });
+  }
+#endif // WASMTIME_FEATURE_ASYNC
+
+  /// \brief Resolves and type-checks the imports of `m` against this linker
+  /// up front, returning an `InstancePre` which can cheaply instantiate `m`
+  /// many times.
+  ///
+  /// Definitions added to this linker afterwards do not affect the returned
+  /// `InstancePre`.
+  Result<InstancePre> instantiate_pre(const Module &m) const {
+    wasmtime_instance_pre_t *pre = nullptr;
+    auto *error =
+        wasmtime_linker_instantiate_pre(ptr.get(), m.ptr.get(), &pre);
+    if (error != nullptr) {
+      return Error(error);
+    }
+    return InstancePre(pre);
+  }
+
   /// Defines instantiations of the module `m` within this linker under the
   /// given `name`.
   Result<std::monostate> module(Store::Context cx, std::string_view name,
@@ -3089,7 +7559,7 @@ public:
   }
 
   /// Attempts to load the specified named item from this linker, returning
-  /// `std::nullopt` if it was not defined.
+  /// `std::nullopt` if it was not defined or is a shared memory.
   [[nodiscard]] std::optional<Extern>
   get(Store::Context cx, std::string_view module, std::string_view name) {
     wasmtime_extern_t item;
@@ -3111,10 +7581,20 @@ public:
                                   std::string_view name, const FuncType &ty,
                                   F&& f) {
 
+#ifdef WASMTIME_CPP_HOST_PROFILING
+    using G = std::remove_reference_t<F>;
+    auto *error = wasmtime_linker_define_func(
+        ptr.get(), module.data(), module.length(), name.data(), name.length(),
+        ty.ptr.get(), raw_profiled_callback<G>,
+        profiled_env(module, name, std::forward<F>(f)),
+        Func::raw_finalize<detail::ProfiledHostFunc<G>>);
+#else
     auto *error = wasmtime_linker_define_func(
         ptr.get(), module.data(), module.length(), name.data(), name.length(),
-        ty.ptr.get(), Func::raw_callback<std::remove_reference_t<F>>, std::make_unique<std::remove_reference_t<F>>(std::forward<F>(f)).release(),
-        Func::raw_finalize<std::remove_reference_t<F>>);
+        ty.ptr.get(), Func::raw_callback<std::remove_reference_t<F>>,
+        detail::HostEnv<std::remove_reference_t<F>>::make(std::forward<F>(f)),
+        detail::HostEnv<std::remove_reference_t<F>>::finalizer);
+#endif // WASMTIME_CPP_HOST_PROFILING
 
     if (error != nullptr) {
       return Error(error);
@@ -3134,18 +7614,130 @@ public:
     auto params = HostFunc::Params::types();
     auto results = HostFunc::Results::types();
     auto ty = FuncType::from_iters(params, results);
+#ifdef WASMTIME_CPP_HOST_PROFILING
+    using G = std::remove_reference_t<F>;
+    auto *error = wasmtime_linker_define_func_unchecked(
+        ptr.get(), module.data(), module.length(), name.data(), name.length(),
+        ty.ptr.get(),
+        raw_profiled_callback_unchecked<G, Func::raw_callback_unchecked<G>>,
+        profiled_env(module, name, std::forward<F>(f)),
+        Func::raw_finalize<detail::ProfiledHostFunc<G>>);
+#else
     auto *error = wasmtime_linker_define_func_unchecked(
         ptr.get(), module.data(), module.length(), name.data(), name.length(),
         ty.ptr.get(), Func::raw_callback_unchecked<std::remove_reference_t<F>>,
-        std::make_unique<std::remove_reference_t<F>>(std::forward<F>(f)).release(), Func::raw_finalize<std::remove_reference_t<F>>);
+        detail::HostEnv<std::remove_reference_t<F>>::make(std::forward<F>(f)),
+        detail::HostEnv<std::remove_reference_t<F>>::finalizer);
+#endif // WASMTIME_CPP_HOST_PROFILING
+
+    if (error != nullptr) {
+      return Error(error);
+    }
+
+    return std::monostate();
+  }
 
+  /// Defines a new function in this linker in the style of the
+  /// `Func::wrap_noexcept` constructor.
+  template <typename F, typename G = std::remove_reference_t<F>,
+            std::enable_if_t<WasmHostFunc<G>::Params::valid, bool> = true,
+            std::enable_if_t<WasmHostFunc<G>::Results::valid, bool> = true,
+            std::enable_if_t<WasmHostFunc<G>::infallible, bool> = true>
+  Result<std::monostate> func_wrap_noexcept(std::string_view module,
+                                            std::string_view name, F &&f) {
+    using HostFunc = WasmHostFunc<G>;
+    auto params = HostFunc::Params::types();
+    auto results = HostFunc::Results::types();
+    auto ty = FuncType::from_iters(params, results);
+#ifdef WASMTIME_CPP_HOST_PROFILING
+    auto *error = wasmtime_linker_define_func_unchecked(
+        ptr.get(), module.data(), module.length(), name.data(), name.length(),
+        ty.ptr.get(),
+        raw_profiled_callback_unchecked<G, Func::raw_callback_noexcept<G>>,
+        profiled_env(module, name, std::forward<F>(f)),
+        Func::raw_finalize<detail::ProfiledHostFunc<G>>);
+#else
+    auto *error = wasmtime_linker_define_func_unchecked(
+        ptr.get(), module.data(), module.length(), name.data(), name.length(),
+        ty.ptr.get(), Func::raw_callback_noexcept<G>,
+        detail::HostEnv<G>::make(std::forward<F>(f)),
+        detail::HostEnv<G>::finalizer);
+#endif // WASMTIME_CPP_HOST_PROFILING
     if (error != nullptr) {
       return Error(error);
     }
+    return std::monostate();
+  }
 
+#ifdef WASMTIME_CPP_COROUTINES
+  /**
+   * \brief Defines a new asynchronous host function in this linker.
+   *
+   * This is like `func_new` except that `f` returns an awaitable (anything
+   * with `await_ready`, `await_suspend`, and `await_resume`, such as a C++20
+   * coroutine task) producing `Result<std::monostate, Trap>`. While the
+   * awaitable is pending the WebAssembly calling it is suspended and the
+   * `CallFuture` driving it stops making progress, freeing up the thread.
+   * Results must be written to the `Span<Val>` before the awaitable
+   * completes. Both spans and the `Caller` remain valid until then.
+   *
+   * Async host functions can only be called through `Func::call_async` and
+   * friends, which requires `Config::async_support`.
+   */
+  template <typename F,
+            std::enable_if_t<std::is_invocable_v<F, Caller, Span<const Val>,
+                                                 Span<Val>>,
+                             bool> = true>
+  Result<std::monostate> func_new_async(std::string_view module,
+                                        std::string_view name,
+                                        const FuncType &ty, F &&f) {
+    using G = std::remove_reference_t<F>;
+    auto *error = wasmtime_linker_define_async_func(
+        ptr.get(), module.data(), module.length(), name.data(), name.length(),
+        ty.ptr.get(), raw_async_callback<G>,
+        std::make_unique<G>(std::forward<F>(f)).release(),
+        Func::raw_finalize<G>);
+    if (error != nullptr) {
+      return Error(error);
+    }
     return std::monostate();
   }
 
+  /**
+   * \brief Defines a new asynchronous host function in this linker in the
+   * style of `func_wrap`.
+   *
+   * The parameters of `f` are the same as those accepted by `func_wrap`,
+   * optionally starting with a `Caller`, but `f` returns an awaitable instead
+   * of a value. What the awaitable produces is interpreted like the return
+   * value of a `func_wrap` callable: nothing, one value, a `std::tuple` of
+   * values, or a `Result<T, Trap>` of those. See `func_new_async` for details
+   * on how async host functions run.
+   */
+  template <typename F,
+            std::enable_if_t<WasmTypeList<typename AsyncHostFunc<
+                                 std::remove_reference_t<F>>::Params>::valid,
+                             bool> = true,
+            std::enable_if_t<WasmHostRet<typename AsyncHostFunc<
+                                 std::remove_reference_t<F>>::Output>::
+                                 Results::valid,
+                             bool> = true>
+  Result<std::monostate> func_wrap_async(std::string_view module,
+                                         std::string_view name, F &&f) {
+    using HostFunc = AsyncHostFunc<std::remove_reference_t<F>>;
+    auto params = WasmTypeList<typename HostFunc::Params>::types();
+    auto results =
+        WasmHostRet<typename HostFunc::Output>::Results::types();
+    auto ty = FuncType::from_iters(params, results);
+    return func_new_async(
+        module, name, ty,
+        [f = std::forward<F>(f)](Caller caller, Span<const Val> args,
+                                 Span<Val> results) mutable {
+          return detail::await_wrapped(f, caller, args, results);
+        });
+  }
+#endif // WASMTIME_CPP_COROUTINES
+
   /// Loads the "default" function, according to WASI commands and reactors, of
   /// the module named `name` in this linker.
   Result<Func> get_default(Store::Context cx, std::string_view name) {
@@ -3159,6 +7751,10 @@ public:
   }
 };
 
+#ifdef WASMTIME_CPP_HOST_PROFILING
+} // namespace host_profiling
+#endif
+
 } // namespace wasmtime
 
 #endif // WASMTIME_HH
@@ -0,0 +1,264 @@
+#include <gtest/gtest.h>
+#include <wasmtime.hh>
+
+using namespace wasmtime;
+
+#ifdef WASMTIME_FEATURE_ASYNC
+
+template <typename T, typename E> T unwrap(Result<T, E> result) {
+  if (result) {
+    return result.ok();
+  }
+  std::cerr << "error: " << result.err().message() << "\n";
+  std::abort();
+}
+
+template <typename T> TrapResult<T> finish(CallFuture<T> future) {
+  while (!future.poll()) {
+  }
+  return future.get();
+}
+
+Engine async_engine() {
+  Config config;
+  config.async_support(true);
+  return Engine(std::move(config));
+}
+
+TEST(CallFuture, Poll) {
+  Engine engine = async_engine();
+  Store store(engine);
+  Linker linker(engine);
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (func (export "add") (param i32 i32) (result i32)
+        local.get 0
+        local.get 1
+        i32.add)
+      (func (export "trap") unreachable))
+  )"));
+  Instance i = unwrap(finish(linker.instantiate_async(store, m)));
+
+  Func add = std::get<Func>(*i.get(store, "add"));
+  auto results = unwrap(finish(add.call_async(store, {1, 2})));
+  EXPECT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].i32(), 3);
+
+  auto typed = unwrap((add.typed<std::tuple<int32_t, int32_t>, int32_t>(store)));
+  EXPECT_EQ(unwrap(finish(typed.call_async(store, {5, 6}))), 11);
+
+  EXPECT_FALSE(finish(add.call_async(store, {1})));
+  Func trap = std::get<Func>(*i.get(store, "trap"));
+  auto err = finish(trap.call_async(store, {})).err();
+  EXPECT_TRUE(std::holds_alternative<Trap>(err.data));
+}
+
+TEST(Scheduler, TimeSlices) {
+  Config config;
+  config.async_support(true);
+  config.epoch_interruption(true);
+  Engine engine(std::move(config));
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (func (export "spin") (param i32) (result i32)
+        (local $i i32)
+        (loop $l
+          (local.set $i (i32.add (local.get $i) (i32.const 1)))
+          (br_if $l (i32.lt_u (local.get $i) (local.get 0))))
+        local.get $i))
+  )"));
+  Linker linker(engine);
+
+  Scheduler scheduler(engine, std::chrono::microseconds(100));
+  auto a = scheduler.add_tenant("a", 1);
+  auto b = scheduler.add_tenant("b", 2);
+  std::vector<std::unique_ptr<Store>> stores;
+  int finished = 0;
+  for (auto tenant : {a, b, a, b}) {
+    stores.push_back(std::make_unique<Store>(engine));
+    Store &store = *stores.back();
+    store.context().set_epoch_deadline(1);
+    Instance i = unwrap(finish(linker.instantiate_async(store, m)));
+    auto spin = unwrap((std::get<Func>(*i.get(store, "spin"))
+                            .typed<int32_t, int32_t>(store)));
+    unwrap(scheduler.spawn(tenant, store, spin.call_async(store, 20000000),
+                           [&](TrapResult<int32_t> result) {
+                             EXPECT_EQ(unwrap(std::move(result)), 20000000);
+                             finished++;
+                           }));
+  }
+  EXPECT_EQ(scheduler.pending(), 4);
+  scheduler.run();
+  EXPECT_EQ(finished, 4);
+  EXPECT_EQ(scheduler.pending(), 0);
+
+  auto stats = scheduler.stats();
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats[a].name, "a");
+  EXPECT_EQ(stats[a].completed, 2);
+  EXPECT_EQ(stats[b].completed, 2);
+  EXPECT_GE(stats[a].slices, 2);
+  EXPECT_GT(stats[b].cpu_time.count(), 0);
+  EXPECT_LE(stats[b].p50_latency, stats[b].max_latency);
+  EXPECT_GT(scheduler.fairness(), 0.0);
+  EXPECT_LE(scheduler.fairness(), 1.0 + 1e-9);
+  EXPECT_FALSE(scheduler.run_once());
+}
+
+#ifdef WASMTIME_CPP_COROUTINES
+
+// An awaitable which completes once the test releases it.
+struct Gate {
+  std::coroutine_handle<> waiter;
+  int32_t value = 0;
+  bool open = false;
+
+  void release(int32_t v) {
+    value = v;
+    open = true;
+    if (waiter) {
+      std::exchange(waiter, nullptr).resume();
+    }
+  }
+
+  struct Awaiter {
+    Gate *gate;
+    bool await_ready() { return gate->open; }
+    void await_suspend(std::coroutine_handle<> h) { gate->waiter = h; }
+    int32_t await_resume() { return gate->value; }
+  };
+};
+
+// A fire-and-forget coroutine.
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::abort(); }
+  };
+};
+
+Detached await_into(CallFuture<int32_t> future, std::optional<int32_t> *out) {
+  auto result = co_await future;
+  *out = unwrap(std::move(result));
+}
+
+const char *kGateWat = R"(
+  (module
+    (import "host" "get" (func $get (param i32) (result i32)))
+    (func (export "run") (param i32) (result i32)
+      local.get 0
+      call $get
+      i32.const 1
+      i32.add))
+)";
+
+TEST(Linker, FuncWrapAsync) {
+  Engine engine = async_engine();
+  Store store(engine);
+  Linker linker(engine);
+  Gate gate;
+  int32_t param = 0;
+  unwrap(linker.func_wrap_async("host", "get", [&](int32_t x) {
+    param = x;
+    return Gate::Awaiter{&gate};
+  }));
+  Module m = unwrap(Module::compile(engine, kGateWat));
+  Instance i = unwrap(finish(linker.instantiate_async(store, m)));
+  auto run = unwrap((std::get<Func>(*i.get(store, "run"))
+                         .typed<int32_t, int32_t>(store)));
+
+  // Polling by hand stalls until the host function completes.
+  auto future = run.call_async(store, 7);
+  EXPECT_FALSE(future.poll());
+  EXPECT_FALSE(future.poll());
+  EXPECT_EQ(param, 7);
+  gate.release(41);
+  EXPECT_TRUE(future.poll());
+  EXPECT_EQ(unwrap(future.get()), 42);
+
+  // Awaiting resumes the awaiting coroutine once the host function completes.
+  gate = Gate();
+  std::optional<int32_t> out;
+  await_into(run.call_async(store, 8), &out);
+  EXPECT_FALSE(out);
+  gate.release(99);
+  EXPECT_EQ(out, 100);
+}
+
+TEST(Linker, FuncNewAsync) {
+  Engine engine = async_engine();
+  Store store(engine);
+  Linker linker(engine);
+
+  struct Ready {
+    Result<std::monostate, Trap> result;
+    bool await_ready() { return true; }
+    void await_suspend(std::coroutine_handle<>) {}
+    Result<std::monostate, Trap> await_resume() { return std::move(result); }
+  };
+  FuncType ty({ValKind::I32}, {ValKind::I32});
+  unwrap(linker.func_new_async(
+      "host", "get", ty,
+      [](Caller, Span<const Val> params, Span<Val> results) {
+        if (params[0].i32() < 0) {
+          return Ready{Trap("negative")};
+        }
+        results[0] = params[0].i32() * 2;
+        return Ready{std::monostate()};
+      }));
+  Module m = unwrap(Module::compile(engine, kGateWat));
+  Instance i = unwrap(finish(linker.instantiate_async(store, m)));
+  Func run = std::get<Func>(*i.get(store, "run"));
+
+  auto results = unwrap(finish(run.call_async(store, {4})));
+  EXPECT_EQ(results[0].i32(), 9);
+  auto err = finish(run.call_async(store, {-1})).err();
+  EXPECT_EQ(err.message().find("negative") != std::string::npos, true);
+}
+
+TEST(Scheduler, BlockedCalls) {
+  Config config;
+  config.async_support(true);
+  config.epoch_interruption(true);
+  Engine engine(std::move(config));
+  Store store(engine);
+  Linker linker(engine);
+  Gate gate;
+  unwrap(linker.func_wrap_async("host", "get",
+                                [&](int32_t) { return Gate::Awaiter{&gate}; }));
+  Module m = unwrap(Module::compile(engine, kGateWat));
+  store.context().set_epoch_deadline(1);
+  Instance i = unwrap(finish(linker.instantiate_async(store, m)));
+  auto run = unwrap((std::get<Func>(*i.get(store, "run"))
+                         .typed<int32_t, int32_t>(store)));
+
+  Scheduler scheduler(engine, std::chrono::microseconds(100));
+  auto tenant = scheduler.add_tenant("a", 1);
+  std::optional<int32_t> out;
+  unwrap(scheduler.spawn(tenant, store, run.call_async(store, 1),
+                         [&](TrapResult<int32_t> result) {
+                           out = unwrap(std::move(result));
+                         }));
+  EXPECT_TRUE(scheduler.run_once());
+  // The call is blocked on the gate, so there's nothing to run.
+  EXPECT_FALSE(scheduler.run_once());
+  EXPECT_EQ(scheduler.pending(), 1);
+
+  // The gate's waiter was set by the first turn, before this thread starts.
+  std::thread releaser([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    gate.release(41);
+  });
+  scheduler.run();
+  releaser.join();
+  EXPECT_EQ(out, 42);
+  // `run` slept rather than polling the blocked call over and over.
+  EXPECT_EQ(scheduler.stats()[tenant].slices, 2);
+}
+
+#endif // WASMTIME_CPP_COROUTINES
+
+#endif // WASMTIME_FEATURE_ASYNC
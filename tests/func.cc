@@ -87,7 +87,7 @@ TEST(TypedFunc, Call) {
     Func f(store, ty, [](auto caller, auto params, auto results) {
       caller.context().gc();
       EXPECT_TRUE(params[0].externref(caller));
-      EXPECT_EQ(std::any_cast<int>(params[0].externref(caller)->data(caller)), 100);
+      EXPECT_EQ(std::any_cast<int>(*params[0].externref(caller)->data(caller)), 100);
       EXPECT_FALSE(params[1].externref(caller));
       results[0] = ExternRef(caller, int(3));
       results[1] = std::optional<ExternRef>(std::nullopt);
@@ -101,7 +101,7 @@ TEST(TypedFunc, Call) {
     auto result =
         func.call(store, {ExternRef(store, int(100)), std::nullopt}).unwrap();
     store.context().gc();
-    EXPECT_EQ(std::any_cast<int>(std::get<0>(result)->data(store)), 3);
+    EXPECT_EQ(std::any_cast<int>(*std::get<0>(result)->data(store)), 3);
     EXPECT_EQ(std::get<1>(result), std::nullopt);
   }
 
@@ -257,3 +257,210 @@ TEST(TypedFunc, WrapRuntime) {
                  .unwrap();
   EXPECT_EQ(ret, 3);
 }
+
+TEST(Func, CallWithResultStorage) {
+  Engine engine;
+  Store store(engine);
+  Func f = Func::wrap(store, [](int32_t a, int64_t b) {
+    return std::make_tuple(a + 1, b + 2);
+  });
+  EXPECT_EQ(f.result_count(store), 2);
+
+  std::array<Val, 2> params = {int32_t(1), int64_t(2)};
+  std::vector<Val> results(f.result_count(store));
+  f.call(store, params, results).unwrap();
+  EXPECT_EQ(results[0].i32(), 2);
+  EXPECT_EQ(results[1].i64(), 4);
+
+  std::vector<Val> too_few(1);
+  EXPECT_FALSE(f.call(store, params, too_few));
+  std::array<Val, 1> wrong_params = {int32_t(1)};
+  EXPECT_FALSE(f.call(store, wrong_params, results));
+
+  Func trap(store, FuncType({}, {}),
+            [](auto caller, auto params, auto results) {
+              return Trap("message");
+            });
+  EXPECT_EQ(trap.result_count(store), 0);
+  auto err = trap.call(store, Span<const Val>(params.data(), 0),
+                       Span<Val>(results.data(), 0))
+                 .err();
+  EXPECT_EQ(err.message(), "message");
+}
+
+TEST(PreparedCall, Smoke) {
+  Engine engine;
+  Store store(engine);
+  Func f = Func::wrap(store, [](int32_t a, double b) { return a + b; });
+
+  EXPECT_FALSE(f.prepare(store, FuncType({ValKind::I32}, {ValKind::F64})));
+  EXPECT_FALSE(
+      f.prepare(store, FuncType({ValKind::I32, ValKind::F64}, {ValKind::I32})));
+  auto call = f.prepare(store, FuncType({ValKind::I32, ValKind::F64},
+                                        {ValKind::F64}))
+                  .unwrap();
+  EXPECT_EQ(call.param_count(), 2);
+  EXPECT_EQ(call.result_count(), 1);
+
+  std::array<Val, 2> params = {int32_t(1), double(2)};
+  std::array<Val, 1> results;
+  for (int i = 0; i < 3; i++) {
+    call.call(store, params, results).unwrap();
+    EXPECT_EQ(results[0].f64(), 3);
+  }
+
+  std::array<Val, 2> wrong_params = {int32_t(1), float(2)};
+  EXPECT_FALSE(call.call(store, wrong_params, results));
+  std::array<Val, 2> wrong_results;
+  EXPECT_FALSE(call.call(store, params, wrong_results));
+}
+
+TEST(PreparedCall, References) {
+  Engine engine;
+  Store store(engine);
+  Func f = Func::wrap(store, [](std::optional<ExternRef> a,
+                                std::optional<Func> b) {
+    return std::make_tuple(b, a);
+  });
+  auto call = f.prepare(store, FuncType({ValKind::ExternRef, ValKind::FuncRef},
+                                        {ValKind::FuncRef, ValKind::ExternRef}))
+                  .unwrap();
+
+  std::array<Val, 2> params = {ExternRef(store, 100), f};
+  std::array<Val, 2> results;
+  call.call(store, params, results).unwrap();
+  EXPECT_TRUE(results[0].funcref());
+  EXPECT_EQ(std::any_cast<int>(*results[1].externref(store)->data(store)), 100);
+
+  params = {std::optional<ExternRef>(), std::optional<Func>()};
+  call.call(store, params, results).unwrap();
+  EXPECT_FALSE(results[0].funcref());
+  EXPECT_FALSE(results[1].externref(store));
+}
+
+TEST(TypedFunc, CallMany) {
+  Engine engine;
+  Store store(engine);
+  Func f = Func::wrap(store, [](int32_t a, int32_t b) -> Result<int32_t, Trap> {
+    if (a < 0) {
+      return Trap("negative");
+    }
+    return a + b;
+  });
+  using Params = std::tuple<int32_t, int32_t>;
+  auto func = f.typed<Params, int32_t>(store).unwrap();
+
+  std::vector<Params> params = {{1, 2}, {3, 4}, {5, 6}};
+  std::vector<int32_t> results(params.size());
+  func.call_many(store, params, results).unwrap();
+  EXPECT_EQ(results, std::vector<int32_t>({3, 7, 11}));
+
+  params[1] = {-1, 0};
+  results.assign(results.size(), 0);
+  auto err = func.call_many(store, params, results).err();
+  EXPECT_EQ(err.index, 1);
+  EXPECT_EQ(err.message(), "negative");
+  EXPECT_EQ(results, std::vector<int32_t>({3, 0, 0}));
+
+  std::vector<int32_t> short_results(1);
+  err = func.call_many(store, params, short_results).err();
+  EXPECT_EQ(err.index, 1);
+  EXPECT_EQ(err.message(), "results shorter than params");
+
+  auto thunk = Func::wrap(store, []() {}).typed<empty_t, empty_t>(store).unwrap();
+  std::vector<empty_t> none(4);
+  thunk.call_many(store, none, none).unwrap();
+}
+
+TEST(Func, WrapNoexcept) {
+  Engine engine;
+  Store store(engine);
+  Func f = Func::wrap_noexcept(store, []() {});
+  f.typed<empty_t, empty_t>(store).unwrap().call(store, empty_t()).unwrap();
+
+  f = Func::wrap_noexcept(store, [](int32_t i, int64_t j) { return i + j; });
+  auto ret = f.typed<std::tuple<int32_t, int64_t>, int64_t>(store)
+                 .unwrap()
+                 .call(store, {1, 2})
+                 .unwrap();
+  EXPECT_EQ(ret, 3);
+
+  f = Func::wrap_noexcept(store, [](double a, float b) {
+    return std::tuple<float, double>(b, a);
+  });
+  auto swapped = f.typed<std::tuple<double, float>, std::tuple<float, double>>(
+                        store)
+                     .unwrap()
+                     .call(store, {1.5, 2.5f})
+                     .unwrap();
+  EXPECT_EQ(std::get<0>(swapped), 2.5f);
+  EXPECT_EQ(std::get<1>(swapped), 1.5);
+
+  f = Func::wrap_noexcept(store, [](Caller cx, std::optional<ExternRef> ref) {
+    return ref.has_value() ? int32_t(1) : int32_t(0);
+  });
+  auto has_ref = f.typed<std::optional<ExternRef>, int32_t>(store).unwrap();
+  EXPECT_EQ(has_ref.call(store, std::nullopt).unwrap(), 0);
+  EXPECT_EQ(has_ref.call(store, ExternRef(store, 5)).unwrap(), 1);
+
+  Linker linker(engine);
+  linker.func_wrap_noexcept("host", "mul", [](int32_t a, int32_t b) {
+    return a * b;
+  }).unwrap();
+  Module m = Module::compile(engine, R"(
+    (module
+      (import "host" "mul" (func $mul (param i32 i32) (result i32)))
+      (func (export "square") (param i32) (result i32)
+        local.get 0
+        local.get 0
+        call $mul))
+  )").unwrap();
+  Instance i = linker.instantiate(store, m).unwrap();
+  auto square = std::get<Func>(*i.get(store, "square"))
+                    .typed<int32_t, int32_t>(store)
+                    .unwrap();
+  EXPECT_EQ(square.call(store, 7).unwrap(), 49);
+}
+
+int32_t add_one(int32_t x) { return x + 1; }
+
+TEST(Func, InlineEnv) {
+  int32_t counter = 0;
+  auto stateless = [](int32_t x) { return x; };
+  auto by_ref = [&counter](int32_t x) { return counter += x; };
+  auto mutable_state = [n = int32_t(0)](int32_t x) mutable { return n += x; };
+  auto large = [a = int64_t(1), b = int64_t(2)](int32_t x) {
+    return int32_t(a + b) + x;
+  };
+  static_assert(HostEnv<decltype(stateless)>::is_inline);
+  static_assert(HostEnv<decltype(by_ref)>::is_inline);
+  static_assert(HostEnv<decltype(&add_one)>::is_inline);
+  static_assert(!HostEnv<decltype(mutable_state)>::is_inline);
+  static_assert(!HostEnv<decltype(large)>::is_inline);
+  static_assert(HostEnv<decltype(stateless)>::finalizer == nullptr);
+
+  Engine engine;
+  Store store(engine);
+  auto call = [&](Func f, int32_t x) {
+    return f.typed<int32_t, int32_t>(store).unwrap().call(store, x).unwrap();
+  };
+  EXPECT_EQ(call(Func::wrap(store, stateless), 3), 3);
+  EXPECT_EQ(call(Func::wrap(store, &add_one), 3), 4);
+  Func f = Func::wrap(store, by_ref);
+  call(f, 2);
+  EXPECT_EQ(call(f, 3), 5);
+  EXPECT_EQ(counter, 5);
+  f = Func::wrap(store, mutable_state);
+  call(f, 2);
+  EXPECT_EQ(call(f, 3), 5);
+  EXPECT_EQ(call(Func::wrap_noexcept(store, large), 1), 4);
+
+  FuncType ty({ValKind::I32}, {ValKind::I32});
+  f = Func(store, ty,
+           [&counter](Caller, Span<const Val> params,
+                      Span<Val> results) -> Result<std::monostate, Trap> {
+             results[0] = params[0].i32() + counter;
+             return std::monostate();
+           });
+  EXPECT_EQ(call(f, 1), 6);
+}
@@ -0,0 +1,87 @@
+#define WASMTIME_CPP_HOST_PROFILING
+
+#include <gtest/gtest.h>
+#include <wasmtime.hh>
+
+using namespace wasmtime;
+
+template <typename T, typename E> T unwrap(Result<T, E> result) {
+  if (result) {
+    return result.ok();
+  }
+  std::cerr << "error: " << result.err().message() << "\n";
+  std::abort();
+}
+
+TEST(HostCallProfiler, Counts) {
+  HostCallProfiler::global().clear();
+  Engine engine;
+  Linker linker(engine);
+  unwrap(linker.func_wrap("host", "add",
+                          [](int32_t a, int32_t b) { return a + b; }));
+  FuncType ty({ValKind::I32}, {});
+  unwrap(linker.func_new(
+      "host", "check", ty,
+      [](Caller caller, Span<const Val> params,
+         Span<Val> results) -> Result<std::monostate, Trap> {
+        if (params[0].i32() < 0) {
+          return Trap("negative");
+        }
+        return std::monostate();
+      }));
+
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (import "host" "add" (func $add (param i32 i32) (result i32)))
+      (import "host" "check" (func $check (param i32)))
+      (func (export "run") (param i32) (result i32)
+        local.get 0
+        call $check
+        local.get 0
+        i32.const 1
+        call $add))
+  )"));
+  Store store(engine);
+  Instance i = unwrap(linker.instantiate(store, m));
+  auto run = unwrap(
+      (std::get<Func>(*i.get(store, "run")).typed<int32_t, int32_t>(store)));
+  for (int32_t x = 0; x < 10; x++) {
+    EXPECT_EQ(unwrap(run.call(store, x)), x + 1);
+  }
+  EXPECT_FALSE(run.call(store, -1));
+
+  auto stats = HostCallProfiler::global().snapshot();
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats[0].module, "host");
+  EXPECT_EQ(stats[0].name, "add");
+  EXPECT_EQ(stats[0].calls, 10);
+  EXPECT_EQ(stats[0].traps, 0);
+  EXPECT_EQ(stats[1].name, "check");
+  EXPECT_EQ(stats[1].calls, 11);
+  EXPECT_EQ(stats[1].traps, 1);
+  uint64_t histogram_calls = 0;
+  for (auto n : stats[1].histogram) {
+    histogram_calls += n;
+  }
+  EXPECT_EQ(histogram_calls, 11);
+  EXPECT_LE(stats[1].mean(), stats[1].total);
+
+  size_t exported = 0;
+  HostCallProfiler::global().for_each(
+      [&](const HostCallStats &s) { exported += s.calls; });
+  EXPECT_EQ(exported, 21);
+}
+
+TEST(HostCallProfiler, SharedNames) {
+  HostCallProfiler::global().clear();
+  Engine engine;
+  for (int i = 0; i < 100; i++) {
+    Linker linker(engine);
+    unwrap(linker.func_wrap("env", "f", [](int32_t a) { return a; }));
+    unwrap(linker.func_wrap("env", "g", []() {}));
+  }
+  auto stats = HostCallProfiler::global().snapshot();
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats[0].name, "f");
+  EXPECT_EQ(stats[1].name, "g");
+}
@@ -1,4 +1,8 @@
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <wasmtime.hh>
 
 using namespace wasmtime;
@@ -25,12 +29,74 @@ TEST(Store, Smoke) {
   store.context().set_epoch_deadline(1);
 }
 
+TEST(Store, EpochDeadlineCallback) {
+  Config config;
+  config.epoch_interruption(true);
+  Engine engine(std::move(config));
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (func (export "spin") (param i32) (result i32)
+        (local $i i32)
+        (loop $l
+          (local.set $i (i32.add (local.get $i) (i32.const 1)))
+          (br_if $l (i32.lt_u (local.get $i) (local.get 0))))
+        local.get $i)
+      (func (export "forever") (loop $l (br $l))))
+  )"));
+  Store store(engine);
+  Instance i = unwrap(Instance::create(store, m, {}));
+  Func spin = std::get<Func>(*i.get(store, "spin"));
+  Func forever = std::get<Func>(*i.get(store, "forever"));
+
+  // Continuing lets the call finish instead of trapping.
+  int calls = 0;
+  store.epoch_deadline_callback(
+      [&](Store::Context cx) -> Result<Store::EpochDeadline> {
+        calls++;
+        engine.increment_epoch();
+        return Store::EpochDeadline::continue_for(1);
+      });
+  store.context().set_epoch_deadline(0);
+  engine.increment_epoch();
+  auto results = unwrap(spin.call(store, {100000}));
+  EXPECT_EQ(results[0].i32(), 100000);
+  EXPECT_GT(calls, 0);
+
+  // Returning an error traps with that error.
+  calls = 0;
+  store.epoch_deadline_callback(
+      [&](Store::Context cx) -> Result<Store::EpochDeadline> {
+        if (++calls == 3) {
+          return Error(wasmtime_error_new("out of time"));
+        }
+        return Store::EpochDeadline::continue_for(0);
+      });
+  store.context().set_epoch_deadline(0);
+  auto err = forever.call(store, {}).err();
+  EXPECT_EQ(calls, 3);
+  EXPECT_NE(err.message().find("out of time"), std::string::npos);
+}
+
 TEST(Engine, Smoke) {
   Engine engine;
   Config config;
   engine = Engine(std::move(config));
 }
 
+TEST(Engine, Precompile) {
+  Engine engine;
+  auto wasm = unwrap(wat2wasm("(module (func (export \"f\")))"));
+  auto artifact = unwrap(engine.precompile(wasm));
+  Module m = unwrap(Module::deserialize(engine, artifact.span()));
+  EXPECT_EQ(m.exports().size(), 1);
+  std::vector<uint8_t> garbage = {1, 2, 3};
+  EXPECT_FALSE(engine.precompile(garbage));
+
+  Config config;
+  EXPECT_FALSE(config.target("not-a-real-target"));
+  config.cranelift_flag_set("opt_level", "speed");
+}
+
 TEST(Config, Smoke) {
   Config config;
   config.debug_info(false);
@@ -55,6 +121,39 @@ TEST(Config, Smoke) {
   Config config3(std::move(config));
 }
 
+#ifdef WASMTIME_FEATURE_POOLING_ALLOCATOR
+TEST(Config, PoolingAllocator) {
+  PoolingAllocationConfig pooling;
+  pooling.total_core_instances(4);
+  pooling.total_memories(4);
+  pooling.total_tables(4);
+  pooling.max_memory_size(1 << 20);
+  pooling.table_elements(100);
+  pooling.linear_memory_keep_resident(4096);
+  pooling.table_keep_resident(4096);
+  pooling.max_unused_warm_slots(2);
+
+  Config config;
+  config.pooling_allocation_strategy(pooling);
+  Engine engine(std::move(config));
+  Module m =
+      unwrap(Module::compile(engine, "(module (memory 1) (table 1 funcref))"));
+  for (int i = 0; i < 10; i++) {
+    Store store(engine);
+    unwrap(Instance::create(store, m, {}));
+  }
+
+  // Only `total_core_instances` instances may be live at once.
+  std::vector<Store> stores;
+  for (int i = 0; i < 4; i++) {
+    stores.emplace_back(engine);
+    unwrap(Instance::create(stores.back(), m, {}));
+  }
+  Store extra(engine);
+  EXPECT_FALSE(Instance::create(extra, m, {}));
+}
+#endif
+
 TEST(wat2wasm, Smoke) {
   wat2wasm("(module)").ok();
   wat2wasm("xxx").err();
@@ -123,6 +222,140 @@ TEST(Module, Serialize) {
   ::remove(path.c_str());
 }
 
+TEST(Module, SerializeBytes) {
+  Engine engine;
+  Module m = unwrap(Module::compile(engine, "(module (func (export \"f\")))"));
+  auto expected = unwrap(m.serialize());
+
+  ByteVec bytes = unwrap(m.serialize_bytes());
+  EXPECT_EQ(std::vector<uint8_t>(bytes.span().begin(), bytes.span().end()),
+            expected);
+  ByteVec moved = std::move(bytes);
+  EXPECT_EQ(moved.size(), expected.size());
+  m = unwrap(Module::deserialize(engine, moved.span()));
+  EXPECT_EQ(m.exports().size(), 1);
+
+  std::stringstream ss;
+  unwrap(m.serialize_to(ss));
+  std::string streamed = ss.str();
+  EXPECT_EQ(std::vector<uint8_t>(streamed.begin(), streamed.end()), expected);
+
+  std::string path("test_serialize_to.cwasm");
+  FILE *fh = ::fopen(path.c_str(), "wb");
+  unwrap(m.serialize_to(fh));
+  ::fclose(fh);
+  m = unwrap(Module::deserialize_file(engine, path));
+  ::remove(path.c_str());
+}
+
+TEST(Module, ImageSize) {
+  Engine engine;
+  Module m = unwrap(Module::compile(engine, "(module (func))"));
+  EXPECT_GT(m.image_size(), 0);
+}
+
+TEST(ModuleCache, Smoke) {
+  Engine engine;
+  auto a = wat2wasm("(module (func (export \"a\")))").unwrap();
+  auto b = wat2wasm("(module (func (export \"b\")))").unwrap();
+  std::vector<uint8_t> invalid = {1, 2, 3};
+
+  ModuleCache cache(engine, std::numeric_limits<size_t>::max());
+  Module m = unwrap(cache.get(a));
+  EXPECT_EQ(m.exports().size(), 1);
+  unwrap(cache.get(a));
+  unwrap(cache.get(b));
+  EXPECT_FALSE(cache.get(invalid));
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 3);
+  EXPECT_EQ(stats.disk_hits, 0);
+  EXPECT_EQ(stats.evictions, 0);
+  EXPECT_EQ(stats.entries, 2);
+  EXPECT_GT(stats.bytes, 0);
+
+  cache.clear();
+  EXPECT_EQ(cache.stats().entries, 0);
+  EXPECT_EQ(cache.stats().bytes, 0);
+}
+
+TEST(ModuleCache, Eviction) {
+  Engine engine;
+  auto a = wat2wasm("(module (func (export \"a\")))").unwrap();
+  auto b = wat2wasm("(module (func (export \"b\")))").unwrap();
+
+  // A zero-byte bound only ever keeps the most recently used module.
+  ModuleCache cache(engine, 0);
+  unwrap(cache.get(a));
+  unwrap(cache.get(b));
+  unwrap(cache.get(b));
+  unwrap(cache.get(a));
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 3);
+  EXPECT_EQ(stats.evictions, 2);
+  EXPECT_EQ(stats.entries, 1);
+}
+
+TEST(ModuleCache, Disk) {
+  auto dir = std::filesystem::temp_directory_path() / "wasmtime-module-cache";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  Engine engine;
+  auto wasm = wat2wasm("(module (func (export \"f\")))").unwrap();
+  {
+    ModuleCache cache(engine, 0, dir.string());
+    unwrap(cache.get(wasm));
+    EXPECT_EQ(cache.stats().misses, 1);
+  }
+  {
+    ModuleCache cache(engine, 0, dir.string());
+    Module m = unwrap(cache.get(wasm));
+    EXPECT_EQ(m.exports().size(), 1);
+    EXPECT_EQ(cache.stats().disk_hits, 1);
+    EXPECT_EQ(cache.stats().misses, 0);
+  }
+
+  // Engines with different settings don't share artifacts.
+  Config config;
+  config.cranelift_opt_level(OptLevel::None);
+  Engine other(std::move(config));
+  {
+    ModuleCache cache(other, 0, dir.string());
+    unwrap(cache.get(wasm));
+    EXPECT_EQ(cache.stats().disk_hits, 0);
+    EXPECT_EQ(cache.stats().misses, 1);
+  }
+
+  // Concurrent writers of the same key leave exactly one intact artifact.
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::vector<std::thread> writers;
+  for (int i = 0; i < 4; i++) {
+    writers.emplace_back([&] {
+      ModuleCache cache(engine, 0, dir.string());
+      unwrap(cache.get(wasm));
+    });
+  }
+  for (auto &t : writers) {
+    t.join();
+  }
+  size_t files = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+    EXPECT_EQ(entry.path().extension(), ".cwasm");
+    files++;
+  }
+  EXPECT_EQ(files, 1u);
+  {
+    ModuleCache cache(engine, 0, dir.string());
+    unwrap(cache.get(wasm));
+    EXPECT_EQ(cache.stats().disk_hits, 1);
+  }
+  std::filesystem::remove_all(dir);
+}
+
 TEST(WasiConfig, Smoke) {
   WasiConfig config;
   config.argv({"x"});
@@ -149,12 +382,73 @@ TEST(ExternRef, Smoke) {
   Store store(engine);
   ExternRef a(store, "foo");
   ExternRef b(store, 3);
-  EXPECT_STREQ(std::any_cast<const char *>(a.data(store)), "foo");
-  EXPECT_EQ(std::any_cast<int>(b.data(store)), 3);
+  EXPECT_STREQ(std::any_cast<const char *>(*a.data(store)), "foo");
+  EXPECT_EQ(std::any_cast<int>(*b.data(store)), 3);
   a.unroot(store);
   a = b;
 }
 
+TEST(ExternRef, Typed) {
+  Engine engine;
+  Store store(engine);
+  auto a = TypedExternRef<std::string>::make(store, "foo");
+  TypedExternRef<int> b(store, 3);
+  EXPECT_EQ(*a.get(store), "foo");
+  EXPECT_EQ(*b.get(store), 3);
+
+  auto c = b.clone(store);
+  *c.get(store) = 4;
+  EXPECT_EQ(*b.get(store), 4);
+  c.unroot(store);
+
+  Val val = a;
+  EXPECT_EQ(val.kind(), ValKind::ExternRef);
+  TypedExternRef<std::string> d(*val.externref(store));
+  EXPECT_EQ(*d.get(store), "foo");
+  d.unroot(store);
+
+  // References of another type are never read as a `T`.
+  TypedExternRef<int> wrong(*a.raw());
+  EXPECT_FALSE(wrong.is(store));
+  EXPECT_EQ(wrong.get(store), nullptr);
+  EXPECT_EQ(a.untyped().data(store), nullptr);
+  ExternRef untyped(store, 3);
+  EXPECT_EQ(TypedExternRef<int>(untyped).get(store), nullptr);
+  untyped.unroot(store);
+  a.unroot(store);
+  b.unroot(store);
+}
+
+TEST(ExternRef, RootScope) {
+  Engine engine;
+  Store store(engine);
+  Func f = Func::wrap(store, [](std::optional<TypedExternRef<int>> ref) {
+    return ref ? 1 : 0;
+  });
+  auto has_ref = f.typed<std::optional<TypedExternRef<int>>, int32_t>(store)
+                     .unwrap();
+  {
+    RootScope scope(store);
+    scope.reserve(10);
+    for (int i = 0; i < 10; i++) {
+      auto ref = scope.make<int>(i);
+      EXPECT_EQ(*ref.get(store), i);
+      EXPECT_EQ(has_ref.call(store, ref).unwrap(), 1);
+    }
+    EXPECT_EQ(has_ref.call(store, std::nullopt).unwrap(), 0);
+    auto untyped = f.typed<std::optional<ExternRef>, int32_t>(store).unwrap();
+    EXPECT_EQ(untyped.call(store, scope.externref(1)).unwrap(), 0);
+    auto other = scope.make<std::string>("x");
+    EXPECT_EQ(untyped.call(store, other.untyped()).unwrap(), 0);
+    scope.adopt(scope.externref(5).clone(store));
+    EXPECT_EQ(scope.size(), 14u);
+    scope.clear();
+    EXPECT_EQ(scope.size(), 0u);
+    scope.make<int>(0);
+  }
+  store.context().gc();
+}
+
 TEST(Val, Smoke) {
   Val val(1);
   EXPECT_EQ(val.kind(), ValKind::I32);
@@ -190,11 +484,11 @@ TEST(Val, Smoke) {
 
   val = std::optional<ExternRef>(ExternRef(store, 5));
   EXPECT_EQ(val.kind(), ValKind::ExternRef);
-  EXPECT_EQ(std::any_cast<int>(val.externref(store)->data(store)), 5);
+  EXPECT_EQ(std::any_cast<int>(*val.externref(store)->data(store)), 5);
 
   val = ExternRef(store, 5);
   EXPECT_EQ(val.kind(), ValKind::ExternRef);
-  EXPECT_EQ(std::any_cast<int>(val.externref(store)->data(store)), 5);
+  EXPECT_EQ(std::any_cast<int>(*val.externref(store)->data(store)), 5);
 
   val = std::optional<Func>(std::nullopt);
   EXPECT_EQ(val.kind(), ValKind::FuncRef);
@@ -250,6 +544,46 @@ TEST(Table, Smoke) {
   EXPECT_EQ(t.type(store)->element().kind(), ValKind::FuncRef);
 }
 
+TEST(Table, Ranges) {
+  Engine engine;
+  Store store(engine);
+  Val null = std::optional<ExternRef>();
+  Table t =
+      unwrap(Table::create(store, TableType(ValKind::ExternRef, 8), null));
+
+  unwrap(t.fill(store, 2, ExternRef(store, 1), 3));
+  EXPECT_FALSE(t.fill(store, 6, null, 3));
+  EXPECT_FALSE(t.fill(store, 0, 3, 1));
+
+  std::vector<Val> vals(8);
+  unwrap(t.get_range(store, 0, vals));
+  EXPECT_FALSE(vals[1].externref(store));
+  EXPECT_EQ(std::any_cast<int>(*vals[2].externref(store)->data(store)), 1);
+  EXPECT_EQ(std::any_cast<int>(*vals[4].externref(store)->data(store)), 1);
+  EXPECT_FALSE(vals[5].externref(store));
+  EXPECT_FALSE(t.get_range(store, 1, vals));
+
+  std::vector<Val> src = {ExternRef(store, 7), ExternRef(store, 8)};
+  unwrap(t.set_range(store, 6, src));
+  EXPECT_FALSE(t.set_range(store, 7, src));
+
+  // Loading into `vals` again leaves copies of the old values rooted.
+  Val kept = vals[2];
+  unwrap(t.copy(store, 3, t, 2, 3));
+  unwrap(t.get_range(store, 0, vals));
+  EXPECT_EQ(std::any_cast<int>(*kept.externref(store)->data(store)), 1);
+  EXPECT_EQ(std::any_cast<int>(*vals[3].externref(store)->data(store)), 1);
+  EXPECT_EQ(std::any_cast<int>(*vals[5].externref(store)->data(store)), 1);
+  EXPECT_EQ(std::any_cast<int>(*vals[6].externref(store)->data(store)), 7);
+
+  Table other =
+      unwrap(Table::create(store, TableType(ValKind::ExternRef, 2), null));
+  unwrap(other.copy(store, 0, t, 6, 2));
+  auto last = other.get(store, 1)->externref(store);
+  EXPECT_EQ(std::any_cast<int>(*last->data(store)), 8);
+  EXPECT_FALSE(other.copy(store, 1, t, 0, 2));
+}
+
 TEST(Memory, Smoke) {
   Engine engine;
   Store store(engine);
@@ -260,6 +594,155 @@ TEST(Memory, Smoke) {
   EXPECT_EQ(m.type(store)->min(), 1);
 }
 
+TEST(Memory, View) {
+  Engine engine;
+  Store store(engine);
+  Memory m = unwrap(Memory::create(store, MemoryType(1)));
+  MemoryView view = m.view(store);
+  EXPECT_EQ(view.size(), 1 << 16);
+
+  EXPECT_TRUE(view.write<uint32_t>(1, 0xdeadbeef));
+  EXPECT_EQ(view.read<uint32_t>(1), 0xdeadbeef);
+  EXPECT_EQ(view.read<uint8_t>(1), 0xef);
+  EXPECT_FALSE(view.read<uint32_t>((1 << 16) - 3));
+  EXPECT_FALSE(view.write<uint64_t>((1 << 16) - 7, 0));
+  EXPECT_FALSE(view.read<uint8_t>(std::numeric_limits<uint64_t>::max()));
+
+  auto words = view.span<uint32_t>(8, 4);
+  ASSERT_TRUE(words);
+  EXPECT_EQ(words->size(), 4);
+  (*words)[0] = 7;
+  EXPECT_EQ(view.read<uint32_t>(8), 7);
+  EXPECT_FALSE(view.span<uint32_t>(9, 1));
+  EXPECT_FALSE(view.span<uint32_t>(8, 1 << 14));
+  EXPECT_FALSE(view.span<uint64_t>(0, std::numeric_limits<size_t>::max()));
+
+  std::vector<uint8_t> in = {1, 2, 3, 4};
+  EXPECT_TRUE(view.copy_in(100, in));
+  std::vector<uint8_t> out(4);
+  EXPECT_TRUE(view.copy_out(100, out));
+  EXPECT_EQ(in, out);
+  EXPECT_FALSE(view.copy_in((1 << 16) - 2, in));
+  EXPECT_FALSE(view.copy_out((1 << 16) - 2, out));
+
+  // Growing the memory is picked up by existing views.
+  unwrap(m.grow(store, 1));
+  EXPECT_EQ(view.size(), 2 << 16);
+  EXPECT_TRUE(view.write<uint32_t>((2 << 16) - 4, 1));
+  EXPECT_EQ(view.read<uint32_t>(100), 0x04030201);
+  EXPECT_EQ(view.read<uint32_t>(1), 0xdeadbeef);
+}
+
+TEST(SharedMemory, Smoke) {
+  Config config;
+  config.wasm_threads(true);
+  Engine engine(std::move(config));
+  SharedMemory m =
+      unwrap(SharedMemory::create(engine, MemoryType::NewShared(1, 3)));
+  EXPECT_TRUE(m.type()->is_shared());
+  EXPECT_EQ(m.size(), 1);
+  EXPECT_EQ(unwrap(m.grow(1)), 1);
+  EXPECT_EQ(m.data().size(), 2 << 16);
+  EXPECT_FALSE(m.grow(2));
+  SharedMemory copy = m;
+  EXPECT_EQ(copy.data().data(), m.data().data());
+
+  EXPECT_FALSE(SharedMemory::create(engine, MemoryType(1, 2)));
+}
+
+TEST(SharedMemory, ManyStores) {
+  Config config;
+  config.wasm_threads(true);
+  Engine engine(std::move(config));
+  SharedMemory m =
+      unwrap(SharedMemory::create(engine, MemoryType::NewShared(1, 1)));
+  Module mod = unwrap(Module::compile(engine, R"(
+    (module
+      (import "" "m" (memory 1 1 shared))
+      (export "m" (memory 0))
+      (func (export "bump")
+        i32.const 0
+        i32.const 1
+        i32.atomic.rmw.add
+        drop))
+  )"));
+
+  auto worker = [&](bool use_linker) {
+    Store store(engine);
+    Instance i = [&] {
+      if (use_linker) {
+        Linker linker(engine);
+        unwrap(linker.define(store, "", "m", m));
+        return unwrap(linker.instantiate(store, mod));
+      }
+      ImportList imports;
+      imports.push_back(m);
+      return unwrap(Instance::create(store, mod, imports));
+    }();
+    EXPECT_FALSE(i.get(store, "m"));
+    auto exported = i.get_shared_memory(store, "m");
+    ASSERT_TRUE(exported);
+    EXPECT_EQ(exported->data().data(), m.data().data());
+    EXPECT_FALSE(i.get_shared_memory(store, "bump"));
+    // Iterating by index doesn't stop at the shared memory.
+    auto first = i.get(store, 0);
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first->first, "m");
+    EXPECT_TRUE(std::holds_alternative<SharedMemory>(first->second));
+    EXPECT_TRUE(std::holds_alternative<Func>(i.get(store, 1)->second));
+    EXPECT_FALSE(i.get(store, 2));
+    Func bump = std::get<Func>(*i.get(store, "bump"));
+    for (int j = 0; j < 100; j++) {
+      unwrap(bump.call(store, {}));
+    }
+  };
+  std::thread a(worker, true);
+  std::thread b(worker, false);
+  a.join();
+  b.join();
+
+  uint32_t count = 0;
+  memcpy(&count, m.data().data(), sizeof(count));
+  EXPECT_EQ(count, 200);
+}
+
+TEST(Memory, ScatterGather) {
+  Engine engine;
+  Store store(engine);
+  Memory m = unwrap(Memory::create(store, MemoryType(1)));
+
+  std::vector<uint8_t> src = {1, 2, 3, 4, 5, 6};
+  std::vector<GuestIoVec> iovs = {{10, 2}, {100, 0}, {20, 4}};
+  EXPECT_EQ(unwrap(m.scatter(store, src, iovs)), 6);
+  EXPECT_EQ(m.data(store)[11], 2);
+  EXPECT_EQ(m.data(store)[20], 3);
+  EXPECT_EQ(m.data(store)[23], 6);
+
+  std::vector<uint8_t> dst(6);
+  EXPECT_EQ(unwrap(m.gather(store, iovs, dst)), 6);
+  EXPECT_EQ(src, dst);
+
+  // Short buffers transfer a prefix.
+  std::vector<uint8_t> small(3);
+  EXPECT_EQ(unwrap(m.gather(store, iovs, small)), 3);
+  EXPECT_EQ(small, std::vector<uint8_t>({1, 2, 3}));
+
+  std::vector<Span<uint8_t>> slices(iovs.size(), Span<uint8_t>(src));
+  unwrap(m.slices(store, iovs, slices));
+  EXPECT_EQ(slices[0].data(), m.data(store).data() + 10);
+  EXPECT_EQ(slices[2].size(), 4);
+  EXPECT_EQ(slices[2][3], 6);
+
+  // Nothing is copied if any range is out of bounds.
+  std::vector<GuestIoVec> bad = {{0, 2}, {(1 << 16) - 1, 2}};
+  EXPECT_FALSE(m.scatter(store, src, bad));
+  EXPECT_EQ(m.data(store)[0], 0);
+  EXPECT_FALSE(m.gather(store, bad, dst));
+  EXPECT_FALSE(m.slices(store, bad, slices));
+  std::vector<Span<uint8_t>> none;
+  EXPECT_FALSE(m.slices(store, iovs, none));
+}
+
 TEST(Instance, Smoke) {
   Engine engine;
   Store store(engine);
@@ -329,6 +812,467 @@ TEST(Linker, Smoke) {
   EXPECT_TRUE(std::holds_alternative<Func>(*linker.get(store, "a", "f")));
 }
 
+TEST(Store, ResourceLimiter) {
+  const size_t page = 65536;
+  struct Limiter : SharedBudgetLimiter {
+    uint64_t elements = 0;
+    Limiter(size_t budget) : SharedBudgetLimiter(budget) {}
+    bool table_growing(uint64_t current, uint64_t desired,
+                       std::optional<uint64_t>) override {
+      if (elements + desired - current > 4) {
+        return false;
+      }
+      elements += desired - current;
+      return true;
+    }
+    void table_released(uint64_t n) override { elements -= n; }
+  };
+  auto limiter = std::make_shared<Limiter>(3 * page);
+  Engine engine;
+
+  {
+    Store a(engine);
+    Store b(engine);
+    a.resource_limiter(limiter);
+    b.resource_limiter(limiter);
+    Memory ma = unwrap(Memory::create(a, MemoryType(2)));
+    EXPECT_EQ(limiter->used(), 2 * page);
+    EXPECT_FALSE(Memory::create(b, MemoryType(2)));
+    EXPECT_EQ(limiter->used(), 2 * page);
+    Memory mb = unwrap(Memory::create(b, MemoryType(0u)));
+    EXPECT_EQ(unwrap(mb.grow(b, 1)), 0);
+    EXPECT_FALSE(ma.grow(a, 1));
+    EXPECT_FALSE(mb.grow(b, 1));
+    EXPECT_EQ(limiter->available(), 0);
+
+    // A growth Wasmtime itself refuses is given back to the budget.
+    Memory capped = unwrap(Memory::create(a, MemoryType(0, 0)));
+    EXPECT_FALSE(capped.grow(a, 1));
+    EXPECT_EQ(limiter->available(), 0);
+
+    Val null = std::optional<Func>();
+    Table t = unwrap(Table::create(a, TableType(ValKind::FuncRef, 3), null));
+    EXPECT_EQ(unwrap(t.grow(a, 1, null)), 3);
+    EXPECT_FALSE(t.grow(a, 1, null));
+    EXPECT_EQ(t.size(a), 4);
+    EXPECT_EQ(limiter->elements, 4);
+  }
+
+  // Dropping the stores gives everything back.
+  EXPECT_EQ(limiter->used(), 0);
+  EXPECT_EQ(limiter->elements, 0);
+
+  // Stores without a limiter aren't affected.
+  Store store(engine);
+  unwrap(Memory::create(store, MemoryType(4)));
+  EXPECT_EQ(limiter->used(), 0);
+}
+
+#ifdef WASMTIME_FEATURE_PROFILING
+TEST(GuestProfiler, Smoke) {
+  Config config;
+  config.epoch_interruption(true);
+  Engine engine(std::move(config));
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (func $spin (export "spin") (param i32) (result i32)
+        (local $i i32)
+        (loop $l
+          (local.set $i (i32.add (local.get $i) (i32.const 1)))
+          (br_if $l (i32.lt_u (local.get $i) (local.get 0))))
+        local.get $i))
+  )"));
+  Store store(engine);
+  Instance i = unwrap(Instance::create(store, m, {}));
+  Func spin = std::get<Func>(*i.get(store, "spin"));
+
+  GuestProfiler profiler("test", std::chrono::milliseconds(1),
+                         {{"spin.wasm", m}});
+  profiler.attach(store);
+  std::atomic<bool> done(false);
+  std::thread ticker([&] {
+    while (!done) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      engine.increment_epoch();
+    }
+  });
+  unwrap(spin.call(store, {50000000}));
+  done = true;
+  ticker.join();
+  profiler.sample(store);
+
+  auto json = unwrap(profiler.finish());
+  ASSERT_GT(json.size(), 0);
+  EXPECT_EQ(json.data()[0], '{');
+}
+#endif // WASMTIME_FEATURE_PROFILING
+
+TEST(Instance, ExportIndex) {
+  Engine engine;
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (func (export "f"))
+      (memory (export "m") 1)
+      (global (export "g") i32 (i32.const 3))
+      (func (export "a") (result i32) i32.const 1))
+  )"));
+  ExportIndex index(m);
+  EXPECT_EQ(index.size(), 4);
+  EXPECT_EQ(index.name(0), "f");
+  auto g = index.find("g");
+  auto a = index.find("a");
+  ASSERT_TRUE(g && a);
+  EXPECT_FALSE(index.find("missing"));
+
+  for (int n = 0; n < 2; n++) {
+    Store store(engine);
+    Instance i = unwrap(Instance::create(store, m, {}));
+    auto exports = unwrap(i.exports(store, index));
+    ASSERT_EQ(exports.size(), 4);
+    EXPECT_EQ(std::get<Global>(exports[*g]).get(store).i32(), 3);
+    auto results = unwrap(std::get<Func>(exports[*a]).call(store, {}));
+    EXPECT_EQ(results[0].i32(), 1);
+    EXPECT_TRUE(std::holds_alternative<Memory>(exports[*index.find("m")]));
+  }
+
+  Store store(engine);
+  Module fewer =
+      unwrap(Module::compile(engine, "(module (func (export \"f\")))"));
+  Instance i = unwrap(Instance::create(store, fewer, {}));
+  EXPECT_FALSE(i.exports(store, index));
+  EXPECT_EQ(unwrap(i.exports(store, ExportIndex(fewer))).size(), 1);
+  Module renamed = unwrap(Module::compile(engine, R"(
+    (module
+      (func (export "f"))
+      (memory (export "m") 1)
+      (global (export "g") i32 (i32.const 3))
+      (func (export "b") (result i32) i32.const 1))
+  )"));
+  Instance j = unwrap(Instance::create(store, renamed, {}));
+  EXPECT_FALSE(j.exports(store, index));
+}
+
+TEST(Instance, ImportList) {
+  Engine engine;
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (import "" "f" (func $f (result i32)))
+      (import "" "g" (global i32))
+      (func (export "run") (result i32)
+        call $f
+        global.get 0
+        i32.add))
+  )"));
+
+  ImportList imports;
+  imports.reserve(2);
+  for (int32_t n = 0; n < 3; n++) {
+    Store store(engine);
+    Func f = Func::wrap(store, [n]() { return n; });
+    Global g = unwrap(Global::create(
+        store, GlobalType(ValKind::I32, false), Val(int32_t(10))));
+    if (imports.size() == 0) {
+      imports.push_back(f);
+      imports.push_back(g);
+    } else {
+      imports.set(0, f);
+      imports.set(1, g);
+    }
+    EXPECT_EQ(imports.size(), 2);
+    Instance i = unwrap(Instance::create(store, m, imports));
+    auto results = unwrap(std::get<Func>(*i.get(store, "run")).call(store, {}));
+    EXPECT_EQ(results[0].i32(), n + 10);
+
+    Instance raw = unwrap(Instance::create(store, m, imports.raw()));
+    EXPECT_TRUE(raw.get(store, "run"));
+  }
+
+  Store store(engine);
+  EXPECT_FALSE(Instance::create(store, m, ImportList()));
+}
+
+TEST(Module, CompileMany) {
+  Engine engine;
+  std::vector<std::vector<uint8_t>> binaries;
+  for (int i = 0; i < 5; i++) {
+    binaries.push_back(unwrap(wat2wasm(
+        "(module (func (export \"f\") (result i32) i32.const " +
+        std::to_string(i) + "))")));
+  }
+  binaries.push_back({0, 1, 2, 3});
+  std::vector<Span<uint8_t>> wasms(binaries.begin(), binaries.end());
+
+  Module::CompileManyOptions options;
+  options.threads = 3;
+  std::vector<size_t> progress;
+  options.progress = [&](size_t finished, size_t total) {
+    EXPECT_EQ(total, 6);
+    progress.push_back(finished);
+  };
+  auto modules = Module::compile_many(engine, wasms, options);
+  ASSERT_EQ(modules.size(), 6);
+  for (int i = 0; i < 5; i++) {
+    Store store(engine);
+    Module m = unwrap(std::move(modules[i]));
+    Instance instance = unwrap(Instance::create(store, m, {}));
+    auto results =
+        unwrap(std::get<Func>(*instance.get(store, "f")).call(store, {}));
+    EXPECT_EQ(results[0].i32(), i);
+  }
+  EXPECT_FALSE(modules[5]);
+  EXPECT_EQ(progress, (std::vector<size_t>{1, 2, 3, 4, 5, 6}));
+
+  std::atomic<bool> cancel(true);
+  options.cancel = &cancel;
+  options.progress = nullptr;
+  for (auto &result : Module::compile_many(engine, wasms, options)) {
+    EXPECT_FALSE(result);
+  }
+  std::vector<Span<uint8_t>> none;
+  EXPECT_TRUE(Module::compile_many(engine, none).empty());
+
+  cancel = false;
+  options.progress = [](size_t finished, size_t) {
+    if (finished == 2) {
+      throw std::runtime_error("stop");
+    }
+  };
+  EXPECT_THROW(Module::compile_many(engine, wasms, options),
+               std::runtime_error);
+}
+
+TEST(ModuleBuilder, Chunks) {
+  Engine engine;
+  auto wasm = unwrap(wat2wasm(R"(
+    (module
+      (func (export "f") (result i32) i32.const 42)
+      (@custom "note" "some bytes"))
+  )"));
+
+  ModuleBuilder builder;
+  builder.reserve(wasm.size());
+  for (size_t i = 0; i < wasm.size(); i += 3) {
+    size_t n = std::min<size_t>(3, wasm.size() - i);
+    unwrap(builder.feed(Span<const uint8_t>(wasm.data() + i, n)));
+  }
+  EXPECT_TRUE(builder.complete());
+  EXPECT_EQ(builder.size(), wasm.size());
+
+  detail::Sha256 hash;
+  hash.update(wasm.data(), wasm.size());
+  EXPECT_EQ(builder.sha256(), detail::Sha256::hex(hash.finish()));
+
+  unwrap(builder.validate(engine));
+  Module m = unwrap(builder.finish(engine));
+  Store store(engine);
+  Instance i = unwrap(Instance::create(store, m, {}));
+  EXPECT_EQ(unwrap(std::get<Func>(*i.get(store, "f")).call(store, {}))[0].i32(),
+            42);
+
+  // Truncated input isn't compiled.
+  ModuleBuilder truncated;
+  unwrap(truncated.feed(Span<const uint8_t>(wasm.data(), wasm.size() - 1)));
+  EXPECT_FALSE(truncated.complete());
+  EXPECT_FALSE(truncated.finish(engine));
+
+  // Anything which isn't WebAssembly is rejected as soon as it's seen.
+  ModuleBuilder bad;
+  std::vector<uint8_t> text = {'<', 'h', 't', 'm', 'l', '>'};
+  EXPECT_FALSE(bad.feed(text));
+  EXPECT_FALSE(bad.feed(wasm));
+}
+
+TEST(Linker, InstantiatePre) {
+  Engine engine;
+  Linker linker(engine);
+  unwrap(linker.func_wrap("host", "double", [](int32_t a) { return a * 2; }));
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (import "host" "double" (func $double (param i32) (result i32)))
+      (func (export "run") (param i32) (result i32)
+        local.get 0
+        call $double))
+  )"));
+  InstancePre pre = unwrap(linker.instantiate_pre(m));
+  EXPECT_EQ(pre.module().imports().size(), 1);
+
+  for (int32_t i = 0; i < 3; i++) {
+    Store store(engine);
+    Instance instance = unwrap(pre.instantiate(store));
+    Func f = std::get<Func>(*instance.get(store, "run"));
+    auto run = unwrap(f.typed<int32_t, int32_t>(store));
+    EXPECT_EQ(unwrap(run.call(store, i)), i * 2);
+  }
+
+  Module missing = unwrap(Module::compile(
+      engine, "(module (import \"host\" \"missing\" (func)))"));
+  EXPECT_FALSE(linker.instantiate_pre(missing));
+}
+
+TEST(StorePool, Smoke) {
+  Config config;
+  config.consume_fuel(true);
+  Engine engine(std::move(config));
+  StorePool pool(engine, 4);
+  pool.fuel(1000);
+  pool.max_uses(2);
+
+  {
+    auto lease = unwrap(pool.checkout());
+    EXPECT_EQ(unwrap(lease.context().get_fuel()), 1000);
+    unwrap(lease.context().set_fuel(10));
+    lease.context().set_data(42);
+  }
+  {
+    auto lease = unwrap(pool.checkout());
+    EXPECT_EQ(unwrap(lease.context().get_fuel()), 1000);
+    EXPECT_FALSE(lease.context().get_data().has_value());
+    EXPECT_FALSE(lease.instance());
+  }
+  // The store has now been used twice, so it's retired rather than reused.
+  unwrap(pool.checkout());
+
+  auto stats = pool.stats();
+  EXPECT_EQ(stats.checkouts, 3);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.retired, 1);
+  EXPECT_GT(stats.hit_rate(), 0.3);
+}
+
+TEST(StorePool, Limits) {
+  Engine engine;
+  Linker linker(engine);
+  Module m = unwrap(Module::compile(engine, "(module (memory 1))"));
+  StorePool pool(engine, 1);
+  pool.limiter(-1, -1, 1, -1, -1);
+  pool.instantiate(unwrap(linker.instantiate_pre(m)));
+
+  // Each store only has room for one instance, so it's replaced every time.
+  for (int i = 0; i < 3; i++) {
+    auto lease = unwrap(pool.checkout());
+    EXPECT_TRUE(lease.instance());
+  }
+  auto stats = pool.stats();
+  EXPECT_EQ(stats.checkouts, 3);
+  EXPECT_EQ(stats.hits + stats.misses, 3);
+  EXPECT_EQ(stats.failures, 0);
+  EXPECT_EQ(stats.retired, 2);
+
+  Module trap = unwrap(Module::compile(engine, R"(
+    (module (func $start unreachable) (start $start))
+  )"));
+  StorePool failing(engine, 1);
+  failing.instantiate(unwrap(linker.instantiate_pre(trap)));
+  EXPECT_FALSE(failing.checkout());
+  stats = failing.stats();
+  EXPECT_EQ(stats.checkouts, 0);
+  EXPECT_EQ(stats.hits + stats.misses, 0);
+  EXPECT_EQ(stats.failures, 1);
+  EXPECT_EQ(stats.hit_rate(), 0.0);
+}
+
+TEST(StorePool, IdleBound) {
+  Engine engine;
+  StorePool pool(engine, 2);
+  std::vector<StorePool::Lease> leases;
+  for (int i = 0; i < 5; i++) {
+    leases.push_back(unwrap(pool.checkout()));
+  }
+  // Release from several threads, which may each map to a different shard.
+  std::vector<std::thread> threads;
+  for (auto &lease : leases) {
+    threads.emplace_back([&lease] { lease.reset(); });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  auto stats = pool.stats();
+  EXPECT_EQ(stats.idle, 2);
+  EXPECT_EQ(stats.retired, 3);
+
+  leases.clear();
+  for (int i = 0; i < 3; i++) {
+    leases.push_back(unwrap(pool.checkout()));
+  }
+  stats = pool.stats();
+  EXPECT_EQ(stats.idle, 0);
+  EXPECT_EQ(stats.hits, 2);
+}
+
+TEST(StorePool, CrossThreadRelease) {
+  Engine engine;
+  StorePool pool(engine, 1);
+  auto lease = unwrap(pool.checkout());
+  std::thread([&] { lease.reset(); }).join();
+  EXPECT_EQ(pool.stats().idle, 1);
+
+  // Whichever shard the store went back to, another thread finds it.
+  std::thread([&] { auto reused = unwrap(pool.checkout()); }).join();
+  auto stats = pool.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.idle, 1);
+}
+
+TEST(StorePool, InstancePre) {
+  Engine engine;
+  Linker linker(engine);
+  Module m = unwrap(Module::compile(engine, R"(
+    (module
+      (global $g (mut i32) (i32.const 0))
+      (func (export "bump") (result i32)
+        global.get $g
+        i32.const 1
+        i32.add
+        global.set $g
+        global.get $g))
+  )"));
+  StorePool pool(engine, 8);
+  pool.instantiate(unwrap(linker.instantiate_pre(m)));
+
+  auto worker = [&] {
+    for (int i = 0; i < 20; i++) {
+      auto lease = unwrap(pool.checkout());
+      Instance instance = *lease.instance();
+      Func f = std::get<Func>(*instance.get(lease.store(), "bump"));
+      auto bump = unwrap(f.typed<std::tuple<>, int32_t>(lease.store()));
+      EXPECT_EQ(unwrap(bump.call(lease.store(), {})), 1);
+    }
+  };
+  std::thread a(worker);
+  std::thread b(worker);
+  a.join();
+  b.join();
+  EXPECT_EQ(pool.stats().checkouts, 40);
+}
+
+TEST(StorePool, PristineInstances) {
+  Config config;
+  config.memory_init_cow(true);
+  Engine engine(std::move(config));
+  Linker linker(engine);
+  auto wasm = unwrap(wat2wasm(R"(
+    (module
+      (memory (export "memory") 1)
+      (data (i32.const 0) "abc"))
+  )"));
+  Module m = unwrap(Module::compile(engine, wasm));
+  StorePool pool(engine, 1);
+  pool.instantiate(unwrap(linker.instantiate_pre(m)));
+
+  for (int i = 0; i < 5; i++) {
+    auto lease = unwrap(pool.checkout());
+    Instance instance = *lease.instance();
+    Memory mem = std::get<Memory>(*instance.get(lease.store(), "memory"));
+    EXPECT_EQ(mem.data(lease.store())[0], 'a');
+    EXPECT_EQ(mem.data(lease.store())[5000], 0);
+    mem.data(lease.store())[0] = 'x';
+    mem.data(lease.store())[5000] = 1;
+  }
+  EXPECT_EQ(pool.stats().hits, 4);
+}
+
 TEST(Linker, CallableMove) {
   Engine engine;
   Linker linker(engine);
@@ -517,3 +1461,45 @@ TEST(Data, Smoke) {
   unwrap(f5.call(store, {}));
   EXPECT_EQ(data.v, nullptr);
 }
+
+TEST(Data, Typed) {
+  struct Counter {
+    std::string name;
+    int calls = 0;
+    bool *dropped;
+    Counter(std::string name, bool *dropped)
+        : name(std::move(name)), dropped(dropped) {}
+    ~Counter() { *dropped = true; }
+  };
+
+  bool dropped = false;
+  {
+    Engine engine;
+    TypedStore<Counter> store(engine, "counter", &dropped);
+    EXPECT_EQ(store.data().name, "counter");
+
+    Func f(store, FuncType({}, {}),
+           [](Caller caller, auto params,
+              auto results) -> Result<std::monostate, Trap> {
+             caller.context().data<Counter>().calls++;
+             return std::monostate();
+           });
+    unwrap(f.call(store, {}));
+    unwrap(f.call(store, {}));
+    EXPECT_EQ(store.data().calls, 2);
+    EXPECT_EQ(store.context().data<Counter>().calls, 2);
+
+    // The type is checked, and untyped data is kept separately.
+    EXPECT_EQ(store.context().try_data<int>(), nullptr);
+    store.context().set_data(5);
+    EXPECT_EQ(std::any_cast<int>(store.context().get_data()), 5);
+    EXPECT_EQ(store.data().calls, 2);
+    Store plain(engine);
+    EXPECT_EQ(plain.context().try_data<Counter>(), nullptr);
+
+    TypedStore<Counter> moved = std::move(store);
+    EXPECT_EQ(moved.data().calls, 2);
+    EXPECT_FALSE(dropped);
+  }
+  EXPECT_TRUE(dropped);
+}
@@ -0,0 +1,267 @@
+// Ahead-of-time compiles a directory of WebAssembly modules into a bundle of
+// artifacts loadable with `Module::deserialize_file`.
+//
+//   wasmtime-precompile [options] <input-dir> <output-dir>
+//
+// Every `*.wasm` file in `<input-dir>` is compiled to `<name>.cwasm` in
+// `<output-dir>`, next to a `manifest.json` recording the Wasmtime version and
+// compilation settings the bundle was built with, and the SHA-256 of each
+// source module. Options:
+//
+//   --target <triple>             cross-compile for another target
+//   --cranelift-enable <flag>     enable a boolean Cranelift setting
+//   --cranelift-set <name>=<val>  set a Cranelift setting
+//   --opt-level <level>           none, speed, or speed_and_size
+
+#include <wasmtime.hh>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace wasmtime;
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+  std::optional<std::string> target;
+  std::vector<std::string> enabled;
+  std::vector<std::pair<std::string, std::string>> settings;
+  std::string opt_level = "speed";
+  fs::path input;
+  fs::path output;
+};
+
+int usage() {
+  std::cerr << "usage: wasmtime-precompile [--target <triple>] "
+               "[--cranelift-enable <flag>] [--cranelift-set <name>=<value>] "
+               "[--opt-level none|speed|speed_and_size] <input-dir> "
+               "<output-dir>\n";
+  return 2;
+}
+
+// Cranelift setting names are lowercase identifiers, like `has_avx2`.
+bool valid_setting_name(std::string_view name) {
+  return !name.empty() && std::all_of(name.begin(), name.end(), [](char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+  });
+}
+
+std::optional<Options> parse_args(int argc, char **argv) {
+  Options options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--target" && has_value) {
+      options.target = argv[++i];
+    } else if (arg == "--cranelift-enable" && has_value) {
+      options.enabled.emplace_back(argv[++i]);
+      if (!valid_setting_name(options.enabled.back())) {
+        return std::nullopt;
+      }
+    } else if (arg == "--cranelift-set" && has_value) {
+      std::string setting = argv[++i];
+      auto eq = setting.find('=');
+      if (eq == std::string::npos || eq + 1 == setting.size() ||
+          !valid_setting_name(std::string_view(setting).substr(0, eq))) {
+        return std::nullopt;
+      }
+      options.settings.emplace_back(setting.substr(0, eq),
+                                    setting.substr(eq + 1));
+    } else if (arg == "--opt-level" && has_value) {
+      options.opt_level = argv[++i];
+    } else if (arg.rfind("--", 0) == 0) {
+      return std::nullopt;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 2) {
+    return std::nullopt;
+  }
+  options.input = positional[0];
+  options.output = positional[1];
+  return options;
+}
+
+std::optional<Config> make_config(const Options &options) {
+  Config config;
+  if (options.target) {
+    auto result = config.target(*options.target);
+    if (!result) {
+      std::cerr << "error: invalid target: " << result.err().message()
+                << "\n";
+      return std::nullopt;
+    }
+  }
+  for (const auto &flag : options.enabled) {
+    config.cranelift_flag_enable(flag);
+  }
+  for (const auto &[name, value] : options.settings) {
+    config.cranelift_flag_set(name, value);
+  }
+  if (options.opt_level == "none") {
+    config.cranelift_opt_level(OptLevel::None);
+  } else if (options.opt_level == "speed") {
+    config.cranelift_opt_level(OptLevel::Speed);
+  } else if (options.opt_level == "speed_and_size") {
+    config.cranelift_opt_level(OptLevel::SpeedAndSize);
+  } else {
+    std::cerr << "error: unknown opt level: " << options.opt_level << "\n";
+    return std::nullopt;
+  }
+  return config;
+}
+
+// Creating an `Engine` with an unknown or invalid Cranelift setting aborts the
+// process, so where possible try it in a child process first to report an
+// error instead.
+bool settings_valid(const Options &options) {
+#ifndef _WIN32
+  if (options.enabled.empty() && options.settings.empty()) {
+    return true;
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    return true;
+  }
+  if (pid == 0) {
+    Engine engine(std::move(*make_config(options)));
+    _exit(0);
+  }
+  int status = 0;
+  if (waitpid(pid, &status, 0) != pid) {
+    return true;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+  return true;
+#endif
+}
+
+std::string json_string(std::string_view s) {
+  std::string ret = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      ret.push_back('\\');
+      ret.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      ret += ' ';
+    } else {
+      ret.push_back(c);
+    }
+  }
+  ret.push_back('"');
+  return ret;
+}
+
+std::string sha256(const std::vector<uint8_t> &bytes) {
+  detail::Sha256 hash;
+  hash.update(bytes.data(), bytes.size());
+  return detail::Sha256::hex(hash.finish());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto options = parse_args(argc, argv);
+  if (!options) {
+    return usage();
+  }
+  auto config = make_config(*options);
+  if (!config) {
+    return 1;
+  }
+  if (!settings_valid(*options)) {
+    std::cerr << "error: invalid Cranelift settings\n";
+    return 1;
+  }
+  Engine engine(std::move(*config));
+
+  std::vector<fs::path> inputs;
+  std::error_code ec;
+  for (const auto &entry : fs::directory_iterator(options->input, ec)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".wasm") {
+      inputs.push_back(entry.path());
+    }
+  }
+  if (ec) {
+    std::cerr << "error: cannot read " << options->input << ": "
+              << ec.message() << "\n";
+    return 1;
+  }
+  std::sort(inputs.begin(), inputs.end());
+  fs::create_directories(options->output, ec);
+  if (ec) {
+    std::cerr << "error: cannot create " << options->output << ": "
+              << ec.message() << "\n";
+    return 1;
+  }
+
+  std::stringstream modules;
+  bool ok = true;
+  for (const auto &input : inputs) {
+    std::ifstream in(input, std::ios::binary | std::ios::ate);
+    std::streamoff size = in.tellg();
+    std::vector<uint8_t> wasm(size > 0 ? size_t(size) : 0);
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(wasm.data()), wasm.size());
+    if (!in) {
+      std::cerr << "error: cannot read " << input << "\n";
+      ok = false;
+      continue;
+    }
+    auto artifact = engine.precompile(wasm);
+    if (!artifact) {
+      std::cerr << "error: " << input.string() << ": "
+                << artifact.err().message() << "\n";
+      ok = false;
+      continue;
+    }
+    auto bytes = artifact.ok();
+    fs::path name = input.stem();
+    name += ".cwasm";
+    std::ofstream out(options->output / name, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    if (!out) {
+      std::cerr << "error: cannot write " << (options->output / name) << "\n";
+      ok = false;
+      continue;
+    }
+    if (modules.tellp() > 0) {
+      modules << ",\n";
+    }
+    modules << "    {\"source\": " << json_string(input.filename().string())
+            << ", \"sha256\": " << json_string(sha256(wasm))
+            << ", \"artifact\": " << json_string(name.string())
+            << ", \"size\": " << bytes.size() << "}";
+    std::cout << input.filename().string() << " -> " << name.string() << "\n";
+  }
+
+  std::stringstream flags;
+  for (const auto &flag : options->enabled) {
+    flags << (flags.tellp() > 0 ? ", " : "") << json_string(flag);
+  }
+  for (const auto &[key, value] : options->settings) {
+    flags << (flags.tellp() > 0 ? ", " : "") << json_string(key + "=" + value);
+  }
+  std::ofstream manifest(options->output / "manifest.json");
+  manifest << "{\n"
+           << "  \"wasmtime\": " << json_string(WASMTIME_VERSION) << ",\n"
+           << "  \"target\": "
+           << json_string(options->target.value_or("host")) << ",\n"
+           << "  \"opt_level\": " << json_string(options->opt_level) << ",\n"
+           << "  \"cranelift\": [" << flags.str() << "],\n"
+           << "  \"modules\": [\n"
+           << modules.str() << (modules.tellp() > 0 ? "\n" : "") << "  ]\n"
+           << "}\n";
+  return ok && manifest ? 0 : 1;
+}